@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+
+// a bump allocator for the nodes of one parse. nodes are made one after
+// another in big blocks (so a function's nodes end up next to each
+// other, in the order they are walked) and are never freed one at a
+// time: deleting the arena gives back every block at once
+class Arena {
+public:
+    Arena() {
+        current = NULL;
+        used = capacity = 0;
+        bytes = 0;
+    }
+
+    ~Arena() {
+        reset();
+    }
+
+    // gives back every node made so far, all at once,
+    // so the arena can be used again from scratch
+    void reset() {
+        // only nodes holding a vector or string have anything to clean up
+        for (int i = 0; i < owners.size(); ++i) {
+            owners[i].destroy(owners[i].node);
+        }
+        for (int i = 0; i < blocks.size(); ++i) {
+            free(blocks[i]);
+        }
+        owners.clear();
+        blocks.clear();
+        current = NULL;
+        used = capacity = 0;
+        bytes = 0;
+    }
+
+    // size bytes for a node. destroy, when given, is run on
+    // the node when the arena goes (see destroyNode)
+    void* allocate(size_t size, void (*destroy)(void*)=NULL) {
+        size = (size + ALIGN - 1) & ~(ALIGN - 1);
+        if (used + size > capacity)
+            grow(size);
+        void* node = current + used;
+        used += size;
+        bytes += size;
+
+        if (destroy != NULL) {
+            Owner o;
+            o.node = node;
+            o.destroy = destroy;
+            owners.push_back(o);
+        }
+        return node;
+    }
+
+    // drops the destructor allocate took for node, when making
+    // it was cut short (by a parse error) and it never got built
+    void forget(void* node) {
+        for (int i = owners.size() - 1; i >= 0; --i) {
+            if (owners[i].node == node) {
+                owners.erase(owners.begin() + i);
+                return;
+            }
+        }
+    }
+
+    // runs T's destructor, for nodes with members that own memory
+    template < typename T >
+    static void destroyNode(void* node) {
+        ((T*) node)->~T();
+    }
+
+    size_t bytes; // handed out since the arena was made (or reset)
+
+private:
+    static const size_t ALIGN = 8; // nodes hold nothing wider than a pointer or double
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    // starts a new block, big enough for at least size bytes
+    void grow(size_t size) {
+        capacity = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+        current = (char*) malloc(capacity);
+        used = 0;
+        blocks.push_back(current);
+    }
+
+    class Owner {
+    public:
+        void* node;
+        void (*destroy)(void*);
+    };
+
+    char* current; // the block being bumped through
+    size_t used, capacity; // of current
+    vector < char* > blocks;
+    vector < Owner > owners;
+
+    // one arena per parse, never copied
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+};
@@ -8,18 +8,18 @@
 
 using namespace std;
 
-class AstPrinter : public ExprVisitor<string> {
+class AstPrinter : public ExprVisitor<AstPrinter, string> {
 public:
     AstPrinter() {}
 
     string print(Expr* e) {
-        return e->accept(this);
+        return visitExpr(e);
     } 
 
     string visitAssignExpr(Assign* e) {
         vector < Expr * > exprs;
         exprs.push_back(e->value);
-        return parenthesize("= " + e->name.lexeme, exprs);
+        return parenthesize("= " + e->name.lexeme(), exprs);
     } 
 
     string visitBinaryExpr(Binary* e) {
@@ -46,12 +46,7 @@ public:
     }
 
     string visitNumberExpr(Number* e) {
-        double n = e->value;
-
-        if (floor(n) != n) // we have a decimal part
-            return to_string(n);
-        else
-            return to_string((int) n);
+        return formatNumber(e->value);
     }
 
     string visitStringExpr(String* e) {
@@ -63,7 +58,7 @@ public:
     }
 
     string visitVariableExpr(Variable* e) {
-        return e->name.lexeme;
+        return e->name.lexeme();
     }
 
     string visitLogicalExpr(Logical* e) {
@@ -79,19 +74,19 @@ public:
     }
 
     string visitGetExpr(Get* g) {
-        return print(g->object) + "." + g->name.lexeme;
+        return print(g->object) + "." + g->name.lexeme();
     }
 
     string visitSetExpr(Set* s) {
-        return print(s->object) + "." + s->name.lexeme + " = " + print(s->value);
+        return print(s->object) + "." + s->name.lexeme() + " = " + print(s->value);
     }
 
     string visitThisExpr(This* t) {
-        return t->keyword.lexeme;
+        return t->keyword.lexeme();
     }
 
     string visitSuperExpr(Super* s) {
-        return s->keyword.lexeme + "." + s->property.lexeme;
+        return s->keyword.lexeme() + "." + s->property.lexeme();
     }
 
 private:
@@ -101,7 +96,7 @@ private:
         for (int i = 0; i < exprs.size(); ++i) {
             Expr *e = exprs[i];
             o.append(" ");
-            o.append(e->accept(this)); // move onto the next expr and represent it
+            o.append(visitExpr(e)); // move onto the next expr and represent it
         }
 
         o.append(")");
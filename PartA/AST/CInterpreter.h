@@ -6,13 +6,131 @@
 #include "../Helpers/ErrHandler.h"
 #include "Stmt.h"
 
-class CInterpreter : public ExprVisitor<Storable *>, public StmtVisitor<void> {
+// parses, resolves and folds the body of a lazily parsed function.
+// defined by the driver (croix.cpp), which knows how
+Block* parseLazyBody(Function* f);
+
+// the runtime surface shared by every execution engine
+// (tree-walking Interpreter and bytecode VM). Callables only
+// ever see a CInterpreter, so they work under either engine
+class CInterpreter {
 public:
-    virtual void executeBlock(Block* e, Environment* sc) = 0;
+    // runs a function body in scope and returns what it returned,
+    // or Value() when it ran off its end
+    virtual Value executeBody(Block* body, Environment* scope) = 0;
+    virtual void interpret(vector < Stmt* > stmts) = 0;
+
+    virtual ~CInterpreter() { }
+
+    // marks the values only this engine knows about (globals, the
+    // current scope, the returned value and heap temps are marked for it)
+    virtual void markRoots() { }
+
+    // runs a collection once enough has been allocated. engines only
+    // call this between statements (or instructions), when every
+    // value still in use is reachable from a root
+    void collectIfNeeded() {
+        if (!heap().shouldCollect())
+            return;
+
+        heap().startCollection();
+        heap().mark(globals);
+        heap().mark(env);
+        markValue(returned);
+        markRoots();
+        heap().finishCollection();
+    }
+
+    // top level names are kept by name in globals, everything
+    // else takes the next slot of the current scope
+    void define(Symbol name, Value v) {
+        if (env == globals)
+            env->define(name, v);
+        else
+            env->defineSlot(v);
+    }
+
+    // keeps a value that is only held in a C++ local alive
+    // while more of the program runs, till it is popped
+    void protect(Value v) {
+        heap().push(v.isObject() ? v.asObject() : NULL);
+    }
+
+    // runs the statements of a block (anything with size() and [])
+    // through engine->execute, with scope as the current scope, till
+    // one doesn't complete normally. the scope before is put back on
+    // the way out, even when a runtime error is thrown
+    template < typename Engine, typename Stmts >
+    Completion executeIn(Engine* engine, const Stmts& stmts, Environment* scope) {
+        Environment* prev = env;
+        Completion done = NORMAL_COMPLETION;
+        // the caller's scope is not reachable from this one
+        int mark = heap().temps.size();
+        heap().push(prev);
+        try {
+            env = scope;
+            for (int i = 0; i < stmts.size(); ++i) {
+                done = engine->execute(stmts[i]);
+                if (done != NORMAL_COMPLETION)
+                    break;
+            }
+        } catch (RuntimeError& err) {
+            // even in the case of an error, reset env
+            env = prev;
+            heap().temps.resize(mark);
+            throw err;
+        }
+
+        env = prev;
+        heap().pop();
+        return done;
+    }
+
+    // what a function body that finished with done returns: the
+    // value of its return statement, or Value() if it ran off its end
+    Value bodyResult(Completion done) {
+        if (done != RETURN_COMPLETION)
+            return Value();
+
+        Value result = returned;
+        returned = Value();
+        return result;
+    }
+
+    // the body of f, parsed the first time it is needed
+    // when f was parsed lazily
+    Block* bodyOf(Function* f) {
+        if (f->body == NULL)
+            return parseLazyBody(f);
+        return f->body;
+    }
+
+    // shows a number, string, boolean or nil. the REPL echoes
+    // expression statements through this, other values show nothing
+    void showValue(Value v) {
+        string text;
+        if (v.isNumber())
+            text = formatNumber(v.asNumber());
+        else if (v.isBool())
+            text = v.asBool() ? "true" : "false";
+        else if (v.isNil())
+            text = "nil";
+        else if (v.asString() != NULL)
+            text = v.asString()->value;
+        else
+            return;
+
+        if (interacting)
+            cout << "\n  " << text << endl;
+        else
+            cout << text << endl;
+    }
+
     ErrHandler* handler;
     AstPrinter pr;
     bool interacting;
     Environment* env;
     Environment* globals;
-    map < Expr*, int > locals;
+    // the value of the return statement being unwound
+    Value returned;
 };
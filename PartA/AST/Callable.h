@@ -12,7 +12,7 @@ using namespace std;
 
 class Callable : public Storable {
 public:
-    virtual Storable* call(CInterpreter* in, vector < Storable* > args) = 0;
+    virtual Value call(CInterpreter* in, vector < Value > args) = 0;
     virtual int arity() = 0;
     virtual string toString() = 0;
     string storedType() {
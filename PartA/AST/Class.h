@@ -2,8 +2,10 @@
 
 #include <iostream>
 #include <map>
+#include <typeinfo>
 #include "Callable.h"
 #include "Functions.h"
+#include "Shape.h"
 #include "../Environment/Environment.h"
 
 using namespace std;
@@ -16,22 +18,57 @@ public:
         cName = name;
         this->methods = methods;
         superclass = super;
+
+        // only the init declared by this class is run on instantiation,
+        // so it is picked out before inherited methods are added
+        init = NULL;
+        Value* declared = methods->find(intern("init"));
+        if (declared != NULL)
+            init = (UserFunction*) declared->asObject();
+
+        // copy down every inherited method this class doesn't override.
+        // the superclass' table is already flat, so finding a method
+        // never walks up the class hierarchy
+        if (super != NULL) {
+            unordered_map < Symbol, Value >& inherited = super->methods->stored;
+            for (unordered_map < Symbol, Value >::iterator it = inherited.begin(); it != inherited.end(); ++it) {
+                if (methods->find(it->first) == NULL)
+                    methods->define(it->first, it->second);
+            }
+        }
     }
 
-    Storable* call(CInterpreter* in, vector < Storable* > args) {
+    Value call(CInterpreter* in, vector < Value > args) {
         CroixClassInstance* instance = new CroixClassInstance(this);
-        UserFunction* init = dynamic_cast<UserFunction*>(methods->find("init"));
-        // some init function was provided
-        // so we bind it to instance to allow access to "this"
-        // then we call it to init fields as required
+        // some init function was provided, so we call it
+        // on instance to init fields as required
         if (init != NULL) {
-            init->bind(instance)->call(in, args);
+            init->invoke(in, Value::object(instance), args);
+        }
+        return Value::object(instance);
+    }
+
+    // the init method declared by this class, if any
+    UserFunction* initializer() {
+        return init;
+    }
+
+    // the method name resolves to on this class, through the cache
+    // of the site looking it up (like a super.name expression)
+    UserFunction* findMethod(Token name, PropertyCache& cache) {
+        if (cache.classId == id) {
+            cacheStats().get.hits++;
+            return cache.method;
         }
-        return instance;
+        cache.missed(cacheStats().get);
+
+        // methods are only ever UserFunctions
+        cache.classId = id;
+        cache.method = (UserFunction*) methods->get(name).asObject();
+        return cache.method;
     }
 
     int arity() {
-        UserFunction* init = dynamic_cast<UserFunction*>(methods->find("init"));
         if (init == NULL) {
             return 0;
         }
@@ -41,70 +78,150 @@ public:
     string toString() {
         return cName;
     }
+
+    void trace() {
+        heap().mark(methods);
+        heap().mark(superclass);
+    }
     
     // I despise C++ for this
     class CroixClassInstance : public Storable {
     public:
         CroixClassInstance(CroixClass* loxclass) {
             definition = loxclass;
-
-            // instead of using Bob's method of findMethod(),
-            // i make an instance of the superclass and link both environments
-            CroixClassInstance* superInst = NULL;
-
-            // make an instance of superclass
-            if (definition->superclass != NULL) {
-                superInst = new CroixClassInstance(definition->superclass);
-            }
-
-            // allows fields to shadow method definitions
-            fields = new Environment(NULL, definition->methods, true);
-            // continue the Environment chain by linking methods of child class to
-            // methods Environment of its parent
-            // 
-            if (superInst != NULL) {
-                definition->methods->parent = superInst->definition->methods;
-            }   
+            shape = Shape::empty();
         }
 
         string storedType() {
             return "<" + definition->cName + " instance>";
         }
 
-        Storable* get(Token name) {
-            Storable* match = fields->get(name);
-            
-            // we have found a method
-            if (match->storedType() == "Callable") {
-                UserFunction* method = dynamic_cast<UserFunction*>(match);
-                if (method != NULL) {
-                   return (Storable*) method->bind(this);
+        // cache is the inline cache of the Get site doing the lookup
+        Value get(Token name, PropertyCache& cache) {
+            UserFunction* method;
+            Value field = lookup(name, cache, method);
+            if (method != NULL)
+                return Value::object(method->bind(Value::object(this)));
+            return rebind(field);
+        }
+
+        // finds name through the cache of the site looking it up.
+        // a field's value is returned, while a method is handed back
+        // unbound through method (which is NULL for fields)
+        Value lookup(Token name, PropertyCache& cache, UserFunction*& method) {
+            method = NULL;
+            if (cache.shape == shape) {
+                if (cache.slot >= 0) {
+                    cacheStats().get.hits++;
+                    return fields[cache.slot];
+                }
+                if (cache.classId == definition->id) {
+                    cacheStats().get.hits++;
+                    method = cache.method;
+                    return Value();
+                }
+            }
+            cache.missed(cacheStats().get);
+
+            // fields shadow method definitions
+            int slot = shape->find(name.symbol);
+            cache.shape = shape;
+            cache.slot = slot;
+            if (slot >= 0)
+                return fields[slot];
+
+            // methods are only ever UserFunctions
+            method = (UserFunction*) definition->methods->get(name).asObject();
+            cache.classId = definition->id;
+            cache.method = method;
+            return Value();
+        }
+
+        // a method read out of a field is bound to this instance
+        // instead of the one it was taken from
+        Value rebind(Value match) {
+            if (match.isObject()) {
+                BoundMethod* bound = dynamic_cast<BoundMethod*>(match.asObject());
+                if (bound != NULL) {
+                   return Value::object(bound->method->bind(Value::object(this)));
                 }
             }
-            // Environment* methods = definition->methods;
-            // map < string, Storable * >::iterator found = fields2.find(name.lexeme);
-
-            // if (found != fields2.end())
-            //     return found->second;
-            
-            // found = definition->methods2.find(name.lexeme);
-            
-            // if (found != definition->methods2.end())
-            //     return found->second;
-
-            // throw RuntimeError(name, "Undefined property " + name.lexeme + ".");
             return match;
         }
 
-        void set(Token name, Storable* newVal) {
-            fields->define(name.lexeme, newVal);
+        // cache is the inline cache of the Set site doing the update
+        void set(Token name, Value newVal, PropertyCache& cache) {
+            if (cache.shape != shape) {
+                cache.missed(cacheStats().set);
+                cache.shape = shape;
+                cache.slot = shape->find(name.symbol);
+                if (cache.slot < 0)
+                    cache.next = shape->transition(name.symbol);
+            } else {
+                cacheStats().set.hits++;
+            }
+
+            if (cache.slot >= 0) {
+                fields[cache.slot] = newVal;
+                return;
+            }
+
+            // a new field moves the instance to the next shape
+            shape = cache.next;
+            fields.push_back(newVal);
+        }
+
+        void trace() {
+            heap().mark(definition);
+            for (int i = 0; i < fields.size(); ++i) {
+                markValue(fields[i]);
+            }
         }
 
         CroixClass* definition;
-        Environment* fields; 
+        Shape* shape;
+        vector < Value > fields; // in the slot order of shape
     };
 
     string cName;
-    Environment* methods;
+    Environment* methods; // inherited methods included
     CroixClass* superclass;
-};
\ No newline at end of file
+    UserFunction* init;
+};
+
+// the class instance a value points to, or NULL. instances are
+// never subclassed, so an exact type check does instead of a cast
+CroixClass::CroixClassInstance* asInstance(Value v) {
+    if (!v.isObject())
+        return NULL;
+
+    Storable* o = v.asObject();
+    if (typeid(*o) != typeid(CroixClass::CroixClassInstance))
+        return NULL;
+    return static_cast<CroixClass::CroixClassInstance*>(o);
+}
+
+// the Callable a Call site is calling, through the site's cache,
+// which holds its arity (and the UserFunction, if it is one).
+// NULL when callee can't be called
+Callable* cachedCallee(CallCache& cache, Value callee) {
+    if (!callee.isObject())
+        return NULL;
+
+    Storable* o = callee.asObject();
+    if (cache.calleeId == o->id) {
+        cacheStats().call.hits++;
+        return cache.callee;
+    }
+
+    Callable* fn = dynamic_cast< Callable *>(o);
+    if (fn == NULL) // not a callable, since it couldn't cast
+        return NULL;
+
+    cache.missed(cacheStats().call);
+    cache.calleeId = o->id;
+    cache.callee = fn;
+    cache.user = dynamic_cast< UserFunction *>(fn);
+    cache.arity = fn->arity();
+    return fn;
+}
\ No newline at end of file
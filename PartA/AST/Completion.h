@@ -0,0 +1,11 @@
+#pragma once
+
+// how a statement finished running. anything but NORMAL_COMPLETION
+// skips the rest of the enclosing blocks, up to the loop or
+// function call that handles it
+enum Completion {
+    NORMAL_COMPLETION,
+    RETURN_COMPLETION,
+    BREAK_COMPLETION,
+    CONTINUE_COMPLETION
+};
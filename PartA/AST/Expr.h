@@ -2,7 +2,7 @@
 // Expr.h
 // Croix
 //
-// Auto-generated by Joshua Pepple on 2022-01-08.
+// Auto-generated by Joshua Pepple on 2026-10-17.
 // CAUTION: Do not hand edit! Edit gen_ast.py instead.
 //
 
@@ -11,6 +11,10 @@
 #include <iostream>
 #include <string>
 #include "Token.h"
+#include "Arena.h"
+#include "Value.h"
+#include "InlineCache.h"
+#include "LocalSlot.h"
 
 using namespace std;
 
@@ -30,511 +34,239 @@ class Set;
 class This;
 class Super;
 
-// class to be inherited by abstract base class
-// to allow the template defined types visit this class
-// it is visited by V1 and returns R1
-// it is visited by V2 and returns R2
-template < typename V1, typename R1, typename V2, typename R2, typename V3, typename R3 >
-class Visitable {
-public:
-    virtual R1 accept(V1) = 0;
-    virtual R2 accept(V2) = 0;
-    virtual R3 accept(V3) = 0;
-};
-
-// class to be inherited by classes that intend to visit
-template < typename ReturnValue >
-class ExprVisitor {
-public:
-    virtual ReturnValue visitAssignExpr(Assign*) = 0;
-    virtual ReturnValue visitBinaryExpr(Binary*) = 0;
-    virtual ReturnValue visitUnaryExpr(Unary*) = 0;
-    virtual ReturnValue visitGroupingExpr(Grouping*) = 0;
-    virtual ReturnValue visitBooleanExpr(Boolean*) = 0;
-    virtual ReturnValue visitNumberExpr(Number*) = 0;
-    virtual ReturnValue visitStringExpr(String*) = 0;
-    virtual ReturnValue visitNilExpr(Nil*) = 0;
-    virtual ReturnValue visitVariableExpr(Variable*) = 0;
-    virtual ReturnValue visitLogicalExpr(Logical*) = 0;
-    virtual ReturnValue visitCallExpr(Call*) = 0;
-    virtual ReturnValue visitGetExpr(Get*) = 0;
-    virtual ReturnValue visitSetExpr(Set*) = 0;
-    virtual ReturnValue visitThisExpr(This*) = 0;
-    virtual ReturnValue visitSuperExpr(Super*) = 0;
+// every kind of node there is, expressions first and then statements.
+// a node keeps its own, which visitors switch on to find its class
+enum NodeKind {
+    NODE_ASSIGN, NODE_BINARY, NODE_UNARY, NODE_GROUPING, NODE_BOOLEAN, NODE_NUMBER, NODE_STRING, NODE_NIL, NODE_VARIABLE, NODE_LOGICAL, NODE_CALL, NODE_GET, NODE_SET, NODE_THIS, NODE_SUPER,
+    NODE_EXPRESSION, NODE_PRINT, NODE_VAR, NODE_BLOCK, NODE_IF, NODE_WHILE, NODE_FUNCTION, NODE_RETURN, NODE_CLASS, NODE_BREAK, NODE_CONTINUE
 };
 
-// used by Environment to store both Exprs
-// and Callables like native functions and
-// user defined functions
-
-class Storable {
+// what every expr node is. nodes have no virtual functions (and
+// so no vtable): what a node is is told by its kind alone
+class Expr {
 public:
-    virtual string storedType() = 0;
-};
-
-// anything that is an ExprVisitor can visit this class
-class Expr : public Visitable < ExprVisitor < string > *, string, ExprVisitor < Storable * > *, Storable *, ExprVisitor < void > *, void >, public Storable {
-public:
-    virtual char type() const = 0;
-
-    string storedType() {
-        return "Expr";
+    uint8_t kind; // a NodeKind
+    
+    // nodes are only made in the Arena of their parse, as in
+    // new (arena) Node(...), and go when the arena does
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size);
     }
+    static void operator delete(void*, Arena&) { }
+    static void operator delete(void*) { }
 
-    virtual ~Expr() { }
+protected:
+    Expr(NodeKind k) {
+        kind = k;
+    }
 };
 
-class Assign : public Expr {
+class Assign final : public Expr {
 public:
-    Assign(Token name, Expr* value) {
+    Assign(Token name, Expr* value) : Expr(NODE_ASSIGN) {
         this->name = name;
         this->value = value;
     }
-    
-    ~Assign() {
-        delete this->value;
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitAssignExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitAssignExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitAssignExpr(this);
-    }
-    
-    char type() const {
-        return '\0';
-    }
 
     Token name;
     Expr* value;
+    LocalSlot local; // set by the Resolver
 };
 
-class Binary : public Expr {
+class Binary final : public Expr {
 public:
-    Binary(Expr* left, Token op, Expr* right) {
+    Binary(Expr* left, Token op, Expr* right) : Expr(NODE_BINARY) {
         this->left = left;
         this->op = op;
         this->right = right;
     }
-    
-    ~Binary() {
-        delete this->left;
-        delete this->right;
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitBinaryExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitBinaryExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitBinaryExpr(this);
-    }
-    
-    char type() const {
-        return 'b';
-    }
 
     Expr* left;
     Token op;
     Expr* right;
 };
 
-class Unary : public Expr {
+class Unary final : public Expr {
 public:
-    Unary(Token op, Expr* right) {
+    Unary(Token op, Expr* right) : Expr(NODE_UNARY) {
         this->op = op;
         this->right = right;
     }
-    
-    ~Unary() {
-        delete this->right;
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitUnaryExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitUnaryExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitUnaryExpr(this);
-    }
-    
-    char type() const {
-        return 'U';
-    }
 
     Token op;
     Expr* right;
 };
 
-class Grouping : public Expr {
+class Grouping final : public Expr {
 public:
-    Grouping(Expr* expr) {
+    Grouping(Expr* expr) : Expr(NODE_GROUPING) {
         this->expr = expr;
     }
-    
-    ~Grouping() {
-        delete this->expr;
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitGroupingExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitGroupingExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitGroupingExpr(this);
-    }
-    
-    char type() const {
-        return 'G';
-    }
 
     Expr* expr;
 };
 
-class Boolean : public Expr {
+class Boolean final : public Expr {
 public:
-    Boolean(bool value) {
+    Boolean(bool value) : Expr(NODE_BOOLEAN) {
         this->value = value;
     }
-    
-    ~Boolean() {
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitBooleanExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitBooleanExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitBooleanExpr(this);
-    }
-    
-    char type() const {
-        return 'B';
-    }
 
     bool value;
 };
 
-class Number : public Expr {
+class Number final : public Expr {
 public:
-    Number(double value) {
+    Number(double value) : Expr(NODE_NUMBER) {
         this->value = value;
     }
-    
-    ~Number() {
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitNumberExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitNumberExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitNumberExpr(this);
-    }
-    
-    char type() const {
-        return 'N';
-    }
 
     double value;
 };
 
-class String : public Expr {
+class String final : public Expr {
 public:
-    String(string value) {
+    String(string value) : Expr(NODE_STRING) {
         this->value = value;
     }
     
-    ~String() {
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size, Arena::destroyNode < String >);
     }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitStringExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitStringExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitStringExpr(this);
-    }
-    
-    char type() const {
-        return 's';
+    static void operator delete(void* node, Arena& arena) {
+        arena.forget(node); // never built
     }
+    static void operator delete(void*) { }
 
     string value;
 };
 
-class Nil : public Expr {
+class Nil final : public Expr {
 public:
-    Nil() {
-    }
-    
-    ~Nil() {
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitNilExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitNilExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitNilExpr(this);
-    }
-    
-    char type() const {
-        return '\0';
+    Nil() : Expr(NODE_NIL) {
     }
 };
 
-class Variable : public Expr {
+class Variable final : public Expr {
 public:
-    Variable(Token name) {
+    Variable(Token name) : Expr(NODE_VARIABLE) {
         this->name = name;
     }
-    
-    ~Variable() {
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitVariableExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitVariableExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitVariableExpr(this);
-    }
-    
-    char type() const {
-        return 'v';
-    }
 
     Token name;
+    LocalSlot local; // set by the Resolver
 };
 
-class Logical : public Expr {
+class Logical final : public Expr {
 public:
-    Logical(Expr* left, Token op, Expr* right) {
+    Logical(Expr* left, Token op, Expr* right) : Expr(NODE_LOGICAL) {
         this->left = left;
         this->op = op;
         this->right = right;
     }
-    
-    ~Logical() {
-        delete this->left;
-        delete this->right;
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitLogicalExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitLogicalExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitLogicalExpr(this);
-    }
-    
-    char type() const {
-        return 'L';
-    }
 
     Expr* left;
     Token op;
     Expr* right;
 };
 
-class Call : public Expr {
+class Call final : public Expr {
 public:
-    Call(Expr* callee, Token rParen, vector < Expr* > arguments) {
+    Call(Expr* callee, Token rParen, vector < Expr* > arguments) : Expr(NODE_CALL) {
         this->callee = callee;
         this->rParen = rParen;
         this->arguments = arguments;
     }
     
-    ~Call() {
-        delete this->callee;
-        for(int i = 0; i < arguments.size(); ++i) {
-            delete arguments[i];
-        }
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitCallExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitCallExpr(this);
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size, Arena::destroyNode < Call >);
     }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitCallExpr(this);
-    }
-    
-    char type() const {
-        return 'C';
+    static void operator delete(void* node, Arena& arena) {
+        arena.forget(node); // never built
     }
+    static void operator delete(void*) { }
 
     Expr* callee;
     Token rParen;
     vector < Expr* > arguments;
+    CallCache cache; // filled in as the node runs
 };
 
-class Get : public Expr {
+class Get final : public Expr {
 public:
-    Get(Expr* object, Token name) {
+    Get(Expr* object, Token name) : Expr(NODE_GET) {
         this->object = object;
         this->name = name;
     }
-    
-    ~Get() {
-        delete this->object;
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitGetExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitGetExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitGetExpr(this);
-    }
-    
-    char type() const {
-        return 'g';
-    }
 
     Expr* object;
     Token name;
+    PropertyCache cache; // filled in as the node runs
 };
 
-class Set : public Expr {
+class Set final : public Expr {
 public:
-    Set(Expr* object, Token name, Expr* value) {
+    Set(Expr* object, Token name, Expr* value) : Expr(NODE_SET) {
         this->object = object;
         this->name = name;
         this->value = value;
     }
-    
-    ~Set() {
-        delete this->object;
-        delete this->value;
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitSetExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitSetExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitSetExpr(this);
-    }
-    
-    char type() const {
-        return 'S';
-    }
 
     Expr* object;
     Token name;
     Expr* value;
+    PropertyCache cache; // filled in as the node runs
 };
 
-class This : public Expr {
+class This final : public Expr {
 public:
-    This(Token keyword) {
+    This(Token keyword) : Expr(NODE_THIS) {
         this->keyword = keyword;
     }
-    
-    ~This() {
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitThisExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitThisExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitThisExpr(this);
-    }
-    
-    char type() const {
-        return 'T';
-    }
 
     Token keyword;
+    LocalSlot local; // set by the Resolver
 };
 
-class Super : public Expr {
+class Super final : public Expr {
 public:
-    Super(Token keyword, Token property) {
+    Super(Token keyword, Token property) : Expr(NODE_SUPER) {
         this->keyword = keyword;
         this->property = property;
     }
-    
-    ~Super() {
-    }
-    
-    string accept(ExprVisitor< string >* ev) {
-        return ev->visitSuperExpr(this);
-    }
-    
-    Storable * accept(ExprVisitor< Storable * >* ev) {
-        return ev->visitSuperExpr(this);
-    }
-    
-    void accept(ExprVisitor< void >* ev) {
-        ev->visitSuperExpr(this);
-    }
-    
-    char type() const {
-        return 'p';
-    }
 
     Token keyword;
     Token property;
+    PropertyCache cache; // filled in as the node runs
+    LocalSlot local; // set by the Resolver
+};
+
+// to be inherited by classes that intend to visit, as in
+// class Foo : public ExprVisitor < Foo, ReturnValue >. visitExpr
+// hands a node to Foo's visit function for its kind with a single
+// switch, and (as they aren't virtual) those can be inlined into it
+template < typename Visitor, typename ReturnValue >
+class ExprVisitor {
+public:
+    ReturnValue visitExpr(Expr* node) {
+        Visitor* v = static_cast < Visitor* >(this);
+        switch (node->kind) {
+            case NODE_ASSIGN: return v->visitAssignExpr(static_cast < Assign* >(node));
+            case NODE_BINARY: return v->visitBinaryExpr(static_cast < Binary* >(node));
+            case NODE_UNARY: return v->visitUnaryExpr(static_cast < Unary* >(node));
+            case NODE_GROUPING: return v->visitGroupingExpr(static_cast < Grouping* >(node));
+            case NODE_BOOLEAN: return v->visitBooleanExpr(static_cast < Boolean* >(node));
+            case NODE_NUMBER: return v->visitNumberExpr(static_cast < Number* >(node));
+            case NODE_STRING: return v->visitStringExpr(static_cast < String* >(node));
+            case NODE_NIL: return v->visitNilExpr(static_cast < Nil* >(node));
+            case NODE_VARIABLE: return v->visitVariableExpr(static_cast < Variable* >(node));
+            case NODE_LOGICAL: return v->visitLogicalExpr(static_cast < Logical* >(node));
+            case NODE_CALL: return v->visitCallExpr(static_cast < Call* >(node));
+            case NODE_GET: return v->visitGetExpr(static_cast < Get* >(node));
+            case NODE_SET: return v->visitSetExpr(static_cast < Set* >(node));
+            case NODE_THIS: return v->visitThisExpr(static_cast < This* >(node));
+            case NODE_SUPER: return v->visitSuperExpr(static_cast < Super* >(node));
+            default: return ReturnValue();
+        }
+    }
 };
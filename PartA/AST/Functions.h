@@ -5,6 +5,9 @@
 
 using namespace std;
 
+class Chunk;
+class BoundMethod;
+
 class NativeFn : public Callable {
 public:
     int arity() {
@@ -17,10 +20,10 @@ public:
 };
 
 class Clock : public NativeFn {
-    Storable* call(CInterpreter* in, vector < Storable* > args) {
+    Value call(CInterpreter* in, vector < Value > args) {
         time_t tme;
         time(&tme);
-        return new Number((double) tme);
+        return Value::number((double) tme);
     }
 };
 
@@ -30,6 +33,7 @@ public:
         this->decl = decl;
         this->closure = clos;
         isInitializer = isInit;        
+        chunk = NULL;
     }    
 
     int arity() {
@@ -37,43 +41,86 @@ public:
     }
 
     string toString() {
-        return "<fn " + decl->fnName.lexeme + ">";
+        return "<fn " + decl->fnName.lexeme() + ">";
     }
 
-    Storable* call(CInterpreter* in, vector < Storable* > args) {
-        Environment* en = new Environment(in->handler, closure);
-        for (int i = 0; i < decl->params.size(); ++i) {
-            // cout << decl->params[i].lexeme << endl;
-            // cout << dynamic_cast<Number*>(args[i])->value << endl;
-            // cout << endl;
-            en->define(decl->params[i].lexeme, args[i]);
-        }
+    Value call(CInterpreter* in, vector < Value > args) {
+        return run(in, new Environment(in->handler, closure), args);
+    }
 
-        try {
-            in->executeBlock(decl->body, new Environment(closure->handler, en));
-        } catch(ReturnExcept r) {
-            if (isInitializer) {
-                // should this be ->getAtDepth(0, Token("this"))
-                return closure->find("this");
-            }
-            return r.value;
-        }
+    // calls this method with receiver as "this", which
+    // takes the slot before the parameters
+    Value invoke(CInterpreter* in, Value receiver, vector < Value >& args) {
+        Environment* en = new Environment(in->handler, closure);
+        en->defineSlot(receiver);
+        Value result = run(in, en, args);
 
-        if (isInitializer) {
-            // should this be ->getAtDepth(0, Token("this"))
-            return closure->find("this");
-        }
-        
-        return NULL;
+        if (isInitializer)
+            return receiver;
+        return result;
     }
 
-    UserFunction* bind(Storable* instance) {
-        Environment* env = new Environment(NULL, closure, true);
-        env->define("this", instance);
-        return new UserFunction(decl, env, isInitializer);
+    // only made when a method is used as a value, instead of being
+    // called straight away
+    BoundMethod* bind(Value instance);
+
+    void trace() {
+        heap().mark(closure);
     }
 
     Function* decl;
     Environment* closure;
     bool isInitializer;
-};
\ No newline at end of file
+    // compiled body, only set when running under the VM
+    Chunk* chunk;
+
+private:
+    // runs the body with args in the slots after whatever en holds
+    Value run(CInterpreter* in, Environment* en, vector < Value >& args) {
+        for (int i = 0; i < decl->params.size(); ++i) {
+            en->defineSlot(args[i]);
+        }
+
+        // nothing else may refer to this function (or its closure)
+        heap().push(this);
+        Value result = in->executeBody(in->bodyOf(decl), new Environment(closure->handler, en));
+        heap().pop();
+        return result;
+    }
+};
+
+// a method together with the instance it was taken from
+class BoundMethod : public Callable {
+public:
+    BoundMethod(Value instance, UserFunction* m) {
+        receiver = instance;
+        method = m;
+    }
+
+    Value call(CInterpreter* in, vector < Value > args) {
+        heap().push(this);
+        Value result = method->invoke(in, receiver, args);
+        heap().pop();
+        return result;
+    }
+
+    int arity() {
+        return method->arity();
+    }
+
+    string toString() {
+        return method->toString();
+    }
+
+    void trace() {
+        markValue(receiver);
+        heap().mark(method);
+    }
+
+    Value receiver;
+    UserFunction* method;
+};
+
+BoundMethod* UserFunction::bind(Value instance) {
+    return new BoundMethod(instance, this);
+}
\ No newline at end of file
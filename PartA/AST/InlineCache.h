@@ -0,0 +1,113 @@
+#pragma once
+
+#include <iostream>
+#include <stdint.h>
+#include "Shape.h"
+
+using namespace std;
+
+class Callable;
+class UserFunction;
+
+// a site that has missed more than this many times after it was
+// first filled sees too many shapes or callees to be worth caching.
+// it still refills on every miss, but those count as megamorphic
+const int MEGAMORPHIC_LIMIT = 4;
+
+// running totals for one kind of cache site, shown by --ic-stats
+class CacheCounters {
+public:
+    CacheCounters() {
+        hits = 0;
+        misses = 0;
+        megamorphic = 0;
+    }
+
+    void report(string kind) {
+        long total = hits + misses + megamorphic;
+        double rate = total == 0 ? 0 : 100.0 * hits / total;
+        cout << "[ic] " << kind << ": " << hits << " hits, " << misses << " misses, ";
+        cout << megamorphic << " megamorphic (" << rate << "% hit)" << endl;
+    }
+
+    long hits;
+    long misses;
+    long megamorphic;
+};
+
+// what a Get, Set or Super site last resolved to, keyed on the
+// receiver's shape (and class, for methods)
+class PropertyCache {
+public:
+    PropertyCache() {
+        shape = NULL;
+        classId = 0;
+        slot = -1;
+        method = NULL;
+        next = NULL;
+        misses = 0;
+    }
+
+    // counts a miss at this site on counters
+    void missed(CacheCounters& counters) {
+        if (shape != NULL || classId != 0)
+            misses++;
+        if (misses > MEGAMORPHIC_LIMIT)
+            counters.megamorphic++;
+        else
+            counters.misses++;
+    }
+
+    Shape* shape;
+    uint64_t classId; // Get and Super only: class the method was found on
+    int slot; // field slot, or -1 when a Get found a method
+    UserFunction* method;
+    Shape* next; // Set only: shape after adding a missing field
+    int misses;
+};
+
+// the callee a Call site last called, by its object id
+// (ids are never reused, so a matching id is the same object)
+class CallCache {
+public:
+    CallCache() {
+        calleeId = 0;
+        callee = NULL;
+        user = NULL;
+        arity = 0;
+        misses = 0;
+    }
+
+    void missed(CacheCounters& counters) {
+        if (callee != NULL)
+            misses++;
+        if (misses > MEGAMORPHIC_LIMIT)
+            counters.megamorphic++;
+        else
+            counters.misses++;
+    }
+
+    uint64_t calleeId;
+    Callable* callee;
+    UserFunction* user; // callee, when it is a UserFunction
+    int arity;
+    int misses;
+};
+
+class CacheStats {
+public:
+    void report() {
+        get.report("get");
+        set.report("set");
+        call.report("call");
+    }
+
+    CacheCounters get;
+    CacheCounters set;
+    CacheCounters call;
+};
+
+CacheStats& cacheStats() {
+    static CacheStats stats;
+    return stats;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "Arena.h"
+
+using namespace std;
+
+class Class;
+
+// where the body of a function is in sourceBuffer(), when the function
+// was parsed lazily. only its braces were matched then, and it is
+// parsed for real (into arena) the first time the function is called
+class LazyBody {
+public:
+    LazyBody(uint32_t offset, uint32_t length, int line, Arena* arena) {
+        this->offset = offset;
+        this->length = length;
+        this->line = line;
+        this->arena = arena;
+        owner = NULL;
+    }
+
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size, Arena::destroyNode < LazyBody >);
+    }
+    static void operator delete(void* node, Arena& arena) {
+        arena.forget(node); // never built
+    }
+    static void operator delete(void*) { }
+
+    uint32_t offset, length; // from its '{' through its '}'
+    int line; // the '{' is on
+    Arena* arena; // of the function's parse
+    Class* owner; // the class a method is declared in, NULL for a function
+};
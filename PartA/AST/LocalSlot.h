@@ -0,0 +1,32 @@
+#pragma once
+
+#include <iostream>
+
+using namespace std;
+
+// where the Resolver found a local: how many scopes up from
+// the use site, and the slot it occupies in that scope. kept on
+// the nodes that name a variable (Variable, Assign, This and Super)
+class LocalSlot {
+public:
+    // the depth of a name the resolver left to the globals
+    static const int GLOBAL = -1;
+
+    // a name is global until the resolver finds it in a scope
+    LocalSlot() {
+        depth = GLOBAL;
+        slot = 0;
+    }
+
+    LocalSlot(int d, int s) {
+        depth = d;
+        slot = s;
+    }
+
+    bool isGlobal() const {
+        return depth == GLOBAL;
+    }
+
+    int depth;
+    int slot;
+};
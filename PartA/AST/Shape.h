@@ -0,0 +1,50 @@
+#pragma once
+
+#include <map>
+#include "Symbol.h"
+
+using namespace std;
+
+// the layout of an instance's fields: which slot each name lives in.
+// shapes form a transition tree rooted at empty(), so instances that
+// get the same fields in the same order share one Shape and only
+// keep their field values. shapes are never freed
+class Shape {
+public:
+    // the shape of an instance with no fields yet
+    static Shape* empty() {
+        static Shape* root = new Shape();
+        return root;
+    }
+
+    // slot of name, or -1 when instances of this shape don't have it
+    int find(Symbol name) {
+        map < Symbol, int >::iterator found = slots.find(name);
+        if (found == slots.end())
+            return -1;
+        return found->second;
+    }
+
+    // the shape reached by adding name as the next field
+    Shape* transition(Symbol name) {
+        map < Symbol, Shape* >::iterator found = transitions.find(name);
+        if (found != transitions.end())
+            return found->second;
+
+        Shape* next = new Shape();
+        next->slots = slots;
+        next->slots[name] = slots.size();
+        transitions[name] = next;
+        return next;
+    }
+
+    int fieldCount() {
+        return slots.size();
+    }
+
+private:
+    Shape() { }
+
+    map < Symbol, int > slots;
+    map < Symbol, Shape* > transitions;
+};
@@ -2,7 +2,7 @@
 // Stmt.h
 // Croix
 //
-// Auto-generated by Joshua Pepple on 2022-01-08.
+// Auto-generated by Joshua Pepple on 2026-10-17.
 // CAUTION: Do not hand edit! Edit gen_ast.py instead.
 //
 
@@ -11,7 +11,9 @@
 #include <iostream>
 #include <string>
 #include "Token.h"
+#include "Arena.h"
 #include "Expr.h"
+#include "Completion.h"
 #include <vector>
 
 using namespace std;
@@ -25,251 +27,197 @@ class While;
 class Function;
 class Return;
 class Class;
+class Break;
+class Continue;
+class LazyBody;
 
-// class to be inherited by abstract base class
-// to allow the template defined types visit this class
-// it is visited by V1 and returns R1
-// it is visited by V2 and returns R2
-template < typename V1, typename R1 >
-class VisitableStmt {
+// what every stmt node is. nodes have no virtual functions (and
+// so no vtable): what a node is is told by its kind alone
+class Stmt {
 public:
-    virtual R1 accept(V1) = 0;
-};
-
-// class to be inherited by classes that intend to visit
-template < typename ReturnValue >
-class StmtVisitor {
-public:
-    virtual ReturnValue visitExpressionStmt(Expression*) = 0;
-    virtual ReturnValue visitPrintStmt(Print*) = 0;
-    virtual ReturnValue visitVarStmt(Var*) = 0;
-    virtual ReturnValue visitBlockStmt(Block*) = 0;
-    virtual ReturnValue visitIfStmt(If*) = 0;
-    virtual ReturnValue visitWhileStmt(While*) = 0;
-    virtual ReturnValue visitFunctionStmt(Function*) = 0;
-    virtual ReturnValue visitReturnStmt(Return*) = 0;
-    virtual ReturnValue visitClassStmt(Class*) = 0;
-};
-
-// anything that is an ExprVisitor can visit this class
-class Stmt : public VisitableStmt < StmtVisitor < void > *, void > {
-public:
-    virtual char type() const = 0;
+    uint8_t kind; // a NodeKind
+    
+    // nodes are only made in the Arena of their parse, as in
+    // new (arena) Node(...), and go when the arena does
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size);
+    }
+    static void operator delete(void*, Arena&) { }
+    static void operator delete(void*) { }
 
-    virtual ~Stmt() { }
+protected:
+    Stmt(NodeKind k) {
+        kind = k;
+    }
 };
 
-class Expression : public Stmt {
+class Expression final : public Stmt {
 public:
-    Expression(Expr* expr) {
+    Expression(Expr* expr) : Stmt(NODE_EXPRESSION) {
         this->expr = expr;
     }
-    
-    ~Expression() {
-        delete this->expr;
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitExpressionStmt(this);
-    }
-    
-    char type() const {
-        return 'E';
-    }
 
     Expr* expr;
 };
 
-class Print : public Stmt {
+class Print final : public Stmt {
 public:
-    Print(Expr* expr) {
+    Print(Expr* expr) : Stmt(NODE_PRINT) {
         this->expr = expr;
     }
-    
-    ~Print() {
-        delete this->expr;
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitPrintStmt(this);
-    }
-    
-    char type() const {
-        return 'P';
-    }
 
     Expr* expr;
 };
 
-class Var : public Stmt {
+class Var final : public Stmt {
 public:
-    Var(Token name, Expr* initValue) {
+    Var(Token name, Expr* initValue) : Stmt(NODE_VAR) {
         this->name = name;
         this->initValue = initValue;
     }
-    
-    ~Var() {
-        delete this->initValue;
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitVarStmt(this);
-    }
-    
-    char type() const {
-        return 'V';
-    }
 
     Token name;
     Expr* initValue;
 };
 
-class Block : public Stmt {
+class Block final : public Stmt {
 public:
-    Block(vector < Stmt* > stmts) {
+    Block(vector < Stmt* > stmts) : Stmt(NODE_BLOCK) {
         this->stmts = stmts;
     }
     
-    ~Block() {
-        for(int i = 0; i < stmts.size(); ++i) {
-            delete stmts[i];
-        }
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size, Arena::destroyNode < Block >);
     }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitBlockStmt(this);
-    }
-    
-    char type() const {
-        return '{';
+    static void operator delete(void* node, Arena& arena) {
+        arena.forget(node); // never built
     }
+    static void operator delete(void*) { }
 
     vector < Stmt* > stmts;
 };
 
-class If : public Stmt {
+class If final : public Stmt {
 public:
-    If(Expr* cond, Stmt* then, Stmt* else_) {
+    If(Expr* cond, Stmt* then, Stmt* else_) : Stmt(NODE_IF) {
         this->cond = cond;
         this->then = then;
         this->else_ = else_;
     }
-    
-    ~If() {
-        delete this->cond;
-        delete this->then;
-        delete this->else_;
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitIfStmt(this);
-    }
-    
-    char type() const {
-        return 'i';
-    }
 
     Expr* cond;
     Stmt* then;
     Stmt* else_;
 };
 
-class While : public Stmt {
+class While final : public Stmt {
 public:
-    While(Expr* cond, Stmt* body) {
+    While(Expr* cond, Stmt* body, Expr* increment) : Stmt(NODE_WHILE) {
         this->cond = cond;
         this->body = body;
-    }
-    
-    ~While() {
-        delete this->cond;
-        delete this->body;
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitWhileStmt(this);
-    }
-    
-    char type() const {
-        return 'W';
+        this->increment = increment;
     }
 
     Expr* cond;
     Stmt* body;
+    Expr* increment;
 };
 
-class Function : public Stmt {
+class Function final : public Stmt {
 public:
-    Function(Token fnName, vector < Token > params, Block* body) {
+    Function(Token fnName, vector < Token > params, Block* body) : Stmt(NODE_FUNCTION) {
         this->fnName = fnName;
         this->params = params;
         this->body = body;
+        this->lazy = NULL;
     }
     
-    ~Function() {
-        delete this->body;
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitFunctionStmt(this);
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size, Arena::destroyNode < Function >);
     }
-    
-    char type() const {
-        return 'F';
+    static void operator delete(void* node, Arena& arena) {
+        arena.forget(node); // never built
     }
+    static void operator delete(void*) { }
 
     Token fnName;
     vector < Token > params;
     Block* body;
+    LazyBody* lazy; // where the body is, while it is left unparsed
 };
 
-class Return : public Stmt {
+class Return final : public Stmt {
 public:
-    Return(Token ret, Expr* value) {
+    Return(Token ret, Expr* value) : Stmt(NODE_RETURN) {
         this->ret = ret;
         this->value = value;
     }
-    
-    ~Return() {
-        delete this->value;
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitReturnStmt(this);
-    }
-    
-    char type() const {
-        return 'R';
-    }
 
     Token ret;
     Expr* value;
 };
 
-class Class : public Stmt {
+class Class final : public Stmt {
 public:
-    Class(Token name, Variable* superclass, vector < Function* > methods) {
+    Class(Token name, Variable* superclass, vector < Function* > methods) : Stmt(NODE_CLASS) {
         this->name = name;
         this->superclass = superclass;
         this->methods = methods;
     }
     
-    ~Class() {
-        delete this->superclass;
-        for(int i = 0; i < methods.size(); ++i) {
-            delete methods[i];
-        }
-    }
-    
-    void accept(StmtVisitor< void >* ev) {
-        ev->visitClassStmt(this);
+    static void* operator new(size_t size, Arena& arena) {
+        return arena.allocate(size, Arena::destroyNode < Class >);
     }
-    
-    char type() const {
-        return 'c';
+    static void operator delete(void* node, Arena& arena) {
+        arena.forget(node); // never built
     }
+    static void operator delete(void*) { }
 
     Token name;
     Variable* superclass;
     vector < Function* > methods;
 };
+
+class Break final : public Stmt {
+public:
+    Break(Token keyword) : Stmt(NODE_BREAK) {
+        this->keyword = keyword;
+    }
+
+    Token keyword;
+};
+
+class Continue final : public Stmt {
+public:
+    Continue(Token keyword) : Stmt(NODE_CONTINUE) {
+        this->keyword = keyword;
+    }
+
+    Token keyword;
+};
+
+// to be inherited by classes that intend to visit, as in
+// class Foo : public StmtVisitor < Foo, ReturnValue >. visitStmt
+// hands a node to Foo's visit function for its kind with a single
+// switch, and (as they aren't virtual) those can be inlined into it
+template < typename Visitor, typename ReturnValue >
+class StmtVisitor {
+public:
+    ReturnValue visitStmt(Stmt* node) {
+        Visitor* v = static_cast < Visitor* >(this);
+        switch (node->kind) {
+            case NODE_EXPRESSION: return v->visitExpressionStmt(static_cast < Expression* >(node));
+            case NODE_PRINT: return v->visitPrintStmt(static_cast < Print* >(node));
+            case NODE_VAR: return v->visitVarStmt(static_cast < Var* >(node));
+            case NODE_BLOCK: return v->visitBlockStmt(static_cast < Block* >(node));
+            case NODE_IF: return v->visitIfStmt(static_cast < If* >(node));
+            case NODE_WHILE: return v->visitWhileStmt(static_cast < While* >(node));
+            case NODE_FUNCTION: return v->visitFunctionStmt(static_cast < Function* >(node));
+            case NODE_RETURN: return v->visitReturnStmt(static_cast < Return* >(node));
+            case NODE_CLASS: return v->visitClassStmt(static_cast < Class* >(node));
+            case NODE_BREAK: return v->visitBreakStmt(static_cast < Break* >(node));
+            case NODE_CONTINUE: return v->visitContinueStmt(static_cast < Continue* >(node));
+            default: return ReturnValue();
+        }
+    }
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+
+using namespace std;
+
+// an interned name: every spelling of the same identifier gets the
+// same small number, so names are compared (and hashed) as integers.
+// 0 is no name at all, like the symbol of a non-identifier token
+typedef uint32_t Symbol;
+
+// FNV-1a over length bytes of text
+inline uint32_t hashName(const char* text, uint32_t length) {
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < length; ++i) {
+        hash = (hash ^ (uint8_t) text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// every name interned so far, for the whole run. an open addressed
+// table maps a name's text to its Symbol, and the Symbol indexes
+// back to the text (for messages) and the hash it was interned with
+class SymbolTable {
+public:
+    SymbolTable() {
+        names.push_back(""); // Symbol 0
+        hashes.push_back(0);
+        table.assign(1024, 0);
+    }
+
+    // the Symbol for text, which was hashed with hashName
+    Symbol intern(const char* text, uint32_t length, uint32_t hash) {
+        uint32_t mask = table.size() - 1;
+        for (uint32_t i = hash & mask; ; i = (i + 1) & mask) {
+            Symbol s = table[i];
+            if (s == 0) {
+                s = names.size();
+                names.push_back(string(text, length));
+                hashes.push_back(hash);
+                table[i] = s;
+                if (names.size() * 2 > table.size())
+                    grow();
+                return s;
+            }
+            if (hashes[s] == hash && names[s].size() == length &&
+                memcmp(names[s].data(), text, length) == 0)
+                return s;
+        }
+    }
+
+    Symbol intern(const string& name) {
+        return intern(name.data(), name.size(), hashName(name.data(), name.size()));
+    }
+
+    const string& name(Symbol s) {
+        return names[s];
+    }
+
+    uint32_t hash(Symbol s) {
+        return hashes[s];
+    }
+
+    int count() {
+        return names.size() - 1;
+    }
+
+private:
+    // doubles the table, keeping it under half full
+    void grow() {
+        table.assign(table.size() * 2, 0);
+        uint32_t mask = table.size() - 1;
+        for (Symbol s = 1; s < names.size(); ++s) {
+            uint32_t i = hashes[s] & mask;
+            while (table[i] != 0) {
+                i = (i + 1) & mask;
+            }
+            table[i] = s;
+        }
+    }
+
+    vector < Symbol > table; // 0 marks an empty bucket
+    vector < string > names;
+    vector < uint32_t > hashes;
+};
+
+// the one table every name is interned in
+SymbolTable& symbols() {
+    static SymbolTable table;
+    return table;
+}
+
+// names the runtime looks up itself, interned once
+Symbol intern(const string& name) {
+    return symbols().intern(name);
+}
@@ -9,29 +9,125 @@
 #define Token_h
 
 #include "TokenTypes.h"
+#include "Symbol.h"
 #include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
 
+// all the source text lexed so far, as one run of offsets. every
+// script and REPL line is added to it, and text is never changed or
+// dropped once it is in, so a token can point at its lexeme by
+// offset for the whole run. scripts are used where they were loaded
+// (like a mapped file), so they are never copied
+class SourceBuffer {
+public:
+    SourceBuffer() {
+        size = 0;
+    }
+
+    // text is used in place, so it must never change or go away.
+    // returns the offset it starts at
+    uint32_t add(const char* text, uint32_t length) {
+        Segment s;
+        s.base = size;
+        s.text = text;
+        segments.push_back(s);
+        size += length;
+        return s.base;
+    }
+
+    // a copy of src that lives as long as the buffer, for text
+    // that would otherwise go away (like a REPL line)
+    const char* keep(const std::string& src) {
+        copies.push_back(src);
+        return copies.back().data();
+    }
+
+    // where the byte at offset lives
+    const char* at(uint32_t offset) {
+        // the last segment starting at or before offset
+        int lo = 0, hi = segments.size() - 1;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (segments[mid].base <= offset)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        return segments[lo].text + (offset - segments[lo].base);
+    }
+
+    uint32_t size; // bytes added so far
+
+private:
+    class Segment {
+    public:
+        uint32_t base;
+        const char* text;
+    };
+
+    std::vector < Segment > segments;
+    std::deque < std::string > copies; // never moves what it holds
+};
+
+// the one buffer every token points into
+SourceBuffer& sourceBuffer() {
+    static SourceBuffer buffer;
+    return buffer;
+}
+
+// a lexeme by position only: where it starts in sourceBuffer()
+// and how long it is, plus the line and column it was found at.
+// identifiers (and this and super) also carry their interned name
 class Token {
 public:
-    Token(TokenType t, std::string lxm, int ln) {
+    Token(TokenType t, uint32_t off, uint32_t len, int ln, int col=0) {
+        type = t;
+        offset = off;
+        length = len;
+        line = ln;
+        column = col;
+        symbol = 0;
+    }
+
+    // a token with no text, like the end of input
+    Token(TokenType t, int ln) {
         type = t;
-        lexeme = lxm;
+        offset = 0;
+        length = 0;
         line = ln;
+        column = 0;
+        symbol = 0;
     }
 
     Token() {
         type = EOF_;
-        lexeme = "";
+        offset = 0;
+        length = 0;
         line = 0;
+        column = 0;
+        symbol = 0;
+    }
+
+    // copies the lexeme out of the source buffer. only done
+    // where an owned string is needed (names, literals, errors)
+    std::string lexeme() const {
+        if (length == 0)
+            return "";
+        return std::string(sourceBuffer().at(offset), length);
     }
 
     std::string String() {
-        return lexeme;
+        return lexeme();
     }
 
     TokenType type;
-    std::string lexeme;
+    uint32_t offset;
+    uint32_t length;
     int line;
+    int column;
+    Symbol symbol; // the lexeme interned, for names (0 for anything else)
 };
 
-#endif
\ No newline at end of file
+#endif
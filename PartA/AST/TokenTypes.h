@@ -24,7 +24,7 @@ enum TokenType {
     
     // reserved identifiers or keywords
     AND, CLASS, ELSE, TRUE_, FALSE_, FUN, FOR, IF, NIL,
-    OR, PRINT, RETURN, SUPER, THIS, VAR, WHILE,
+    OR, PRINT, RETURN, SUPER, THIS, VAR, WHILE, BREAK, CONTINUE,
     
     EOF_
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "../GC/Heap.h"
+
+using namespace std;
+
+// base of every heap object a Value can point to:
+// strings, callables (functions and classes) and class instances
+class Storable : public GcObject {
+public:
+    Storable() {
+        static uint64_t lastId = 0;
+        id = ++lastId;
+    }
+
+    virtual string storedType() = 0;
+
+    virtual ~Storable() { }
+
+    // never reused, unlike addresses, so inline caches can key on it
+    uint64_t id;
+};
+
+// strings made at runtime (literals and concatenations)
+class CroixString : public Storable {
+public:
+    CroixString(string v) {
+        value = v;
+    }
+
+    string storedType() {
+        return "String";
+    }
+
+    string value;
+};
+
+// a Croix value packed into 64 bits (NaN boxing).
+// numbers are stored as plain doubles. nil, booleans, the "no value"
+// of a call that returned nothing and pointers to heap objects
+// live in the unused payload of a quiet NaN, so none of them
+// need an allocation
+class Value {
+public:
+    // the "no value" result, like a function falling off its end
+    Value() {
+        bits = QNAN | TAG_NONE;
+    }
+
+    static Value number(double n) {
+        Value v;
+        memcpy(&v.bits, &n, sizeof(double));
+        return v;
+    }
+
+    static Value boolean(bool b) {
+        return Value(QNAN | TAG_FALSE | (uint64_t) b);
+    }
+
+    static Value nil() {
+        return Value(QNAN | TAG_NIL);
+    }
+
+    static Value none() {
+        return Value(QNAN | TAG_NONE);
+    }
+
+    static Value object(Storable* o) {
+        return Value(SIGN_BIT | QNAN | (uint64_t)(uintptr_t) o);
+    }
+
+    bool isNumber() const {
+        return (bits & QNAN) != QNAN;
+    }
+
+    bool isBool() const {
+        return (bits | 1) == (QNAN | TAG_TRUE);
+    }
+
+    bool isNil() const {
+        return bits == (QNAN | TAG_NIL);
+    }
+
+    bool isNone() const {
+        return bits == (QNAN | TAG_NONE);
+    }
+
+    bool isObject() const {
+        return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT);
+    }
+
+    double asNumber() const {
+        double n;
+        memcpy(&n, &bits, sizeof(double));
+        return n;
+    }
+
+    bool asBool() const {
+        return bits == (QNAN | TAG_TRUE);
+    }
+
+    Storable* asObject() const {
+        return (Storable*)(uintptr_t)(bits & ~(SIGN_BIT | QNAN));
+    }
+
+    // heap string payload, or NULL for any other value
+    CroixString* asString() const {
+        if (!isObject())
+            return NULL;
+        return dynamic_cast<CroixString*>(asObject());
+    }
+
+private:
+    explicit Value(uint64_t raw) {
+        bits = raw;
+    }
+
+    static const uint64_t SIGN_BIT = 0x8000000000000000ULL;
+    static const uint64_t QNAN = 0x7ffc000000000000ULL;
+    static const uint64_t TAG_NIL = 1;
+    static const uint64_t TAG_FALSE = 2; // TAG_TRUE must stay TAG_FALSE | 1
+    static const uint64_t TAG_TRUE = 3;
+    static const uint64_t TAG_NONE = 4;
+
+    uint64_t bits;
+};
+
+// marks the heap object v points to, if any
+void markValue(Value v) {
+    if (v.isObject())
+        heap().mark(v.asObject());
+}
+
+// whole numbers print without a decimal part
+string formatNumber(double n) {
+    if (floor(n) != n) // we have a decimal part
+        return to_string(n);
+    else
+        return to_string((int) n);
+}
@@ -0,0 +1,530 @@
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include "../AST/Expr.h"
+#include "../AST/Stmt.h"
+#include "../AST/Token.h"
+#include "../AST/CInterpreter.h"
+#include "../Helpers/ErrHandler.h"
+#include "../VM/Chunk.h"
+
+using namespace std;
+
+// forward jumps out of the loop being compiled,
+// patched once the loop's end is known
+class LoopJumps {
+public:
+    LoopJumps(int depth) {
+        scopeDepth = depth;
+    }
+
+    int scopeDepth; // blocks entered inside the loop body are left on a jump
+    vector < int > breaks;
+    vector < int > continues;
+};
+
+// turns a resolved syntax tree into bytecode for the VM.
+// variable depths come from the slots the Resolver left on
+// the nodes, so resolving must happen first
+class Compiler : public ExprVisitor<Compiler, void>, public StmtVisitor<Compiler, void> {
+public:
+    Compiler(CInterpreter* in, ErrHandler* e, bool interactiveMode=false) {
+        interpreter = in;
+        handler = e;
+        interacting = interactiveMode;
+        current = NULL;
+        line = 0;
+        scopeDepth = 0;
+        declaredCallables = false;
+    }
+
+    // every function body compiled so far, keyed by its Block.
+    // shared across compilers so REPL lines can call functions
+    // compiled for earlier lines
+    static map < Block*, Chunk* >& bodies() {
+        static map < Block*, Chunk* > compiled;
+        return compiled;
+    }
+
+    // every chunk made and not yet released, oldest first.
+    // the VM marks their constants for as long as they are here
+    static vector < Chunk* >& chunks() {
+        static vector < Chunk* > made;
+        return made;
+    }
+
+    // frees the chunks made since there were mark of them (with
+    // their classes), once nothing is left that could run them
+    static void release(int mark) {
+        vector < Chunk* >& made = chunks();
+        for (int i = mark; i < made.size(); ++i) {
+            if (made[i]->block != NULL)
+                bodies().erase(made[i]->block);
+            delete made[i];
+        }
+        made.resize(mark);
+    }
+
+    Chunk* compile(vector < Stmt* > stmts) {
+        Chunk* script = newChunk();
+        current = script;
+        for (int i = 0; i < stmts.size(); ++i) {
+            compile(stmts[i]);
+        }
+        emit(OP_VOID);
+        emit(OP_RETURN);
+        return script;
+    }
+
+    // compiles the body of fn into its own chunk. the chunk of a
+    // lazily parsed function is left empty, for compileLazy
+    Chunk* compileFunction(Function* fn) {
+        if (fn->body == NULL)
+            return newChunk(fn);
+        line = fn->fnName.line;
+        return compileBody(fn->body, fn);
+    }
+
+    // the chunk of a lazily parsed function, given the empty one its
+    // declaration got. its body is parsed and compiled into that one,
+    // unless the body was already compiled on its own (as executeBody
+    // does for an initializer), whose chunk is then the one to use
+    Chunk* compileLazy(Chunk* chunk) {
+        Block* block = interpreter->bodyOf(chunk->decl);
+        map < Block*, Chunk* >::iterator found = bodies().find(block);
+        if (found != bodies().end())
+            return found->second;
+        line = chunk->decl->fnName.line;
+        return compileBody(block, chunk->decl, chunk);
+    }
+
+    // compiles a function body into its own chunk
+    // (or into body, when it is given)
+    Chunk* compileBody(Block* block, Function* fn=NULL, Chunk* body=NULL) {
+        Chunk* enclosing = current;
+        int enclosingLine = line;
+        if (body == NULL)
+            body = newChunk(fn);
+        vector < LoopJumps > enclosingLoops = loops;
+        current = body;
+        scopeDepth++;
+        loops.clear();
+
+        // the body runs directly in the scope the call creates
+        // for it, so its statements are not wrapped in a block
+        for (int i = 0; i < block->stmts.size(); ++i) {
+            compile(block->stmts[i]);
+        }
+        emit(OP_VOID);
+        emit(OP_RETURN);
+
+        body->block = block;
+        bodies()[block] = body;
+        loops = enclosingLoops;
+        scopeDepth--;
+        current = enclosing;
+        line = enclosingLine;
+        return body;
+    }
+
+    void visitExpressionStmt(Expression* e) {
+        compile(e->expr);
+        emit(interacting ? OP_SHOW : OP_POP);
+    }
+
+    void visitPrintStmt(Print* e) {
+        if (e->expr != NULL) {
+            compile(e->expr);
+            emit(OP_PRINT);
+        } else {
+            emit(OP_PRINT_EMPTY);
+        }
+    }
+
+    void visitVarStmt(Var* e) {
+        line = e->name.line;
+        if (e->initValue) {
+            compile(e->initValue);
+        } else {
+            emit(OP_NIL);
+        }
+        define(e->name);
+    }
+
+    void visitBlockStmt(Block* e) {
+        emit(OP_PUSH_SCOPE);
+        scopeDepth++;
+        for (int i = 0; i < e->stmts.size(); ++i) {
+            compile(e->stmts[i]);
+        }
+        scopeDepth--;
+        emit(OP_POP_SCOPE);
+    }
+
+    void visitIfStmt(If* e) {
+        compile(e->cond);
+        int thenJump = emitJump(OP_JUMP_IF_FALSE);
+        emit(OP_POP);
+        compile(e->then);
+        int elseJump = emitJump(OP_JUMP);
+
+        patchJump(thenJump);
+        emit(OP_POP);
+        if (e->else_ != NULL)
+            compile(e->else_);
+        patchJump(elseJump);
+    }
+
+    void visitWhileStmt(While* e) {
+        int loopStart = current->code.size();
+        compile(e->cond);
+
+        int exitJump = emitJump(OP_JUMP_IF_FALSE);
+        emit(OP_POP);
+        loops.push_back(LoopJumps(scopeDepth));
+        compile(e->body);
+        LoopJumps jumps = loops.back();
+        loops.pop_back();
+
+        // continue still runs the increment of a for loop
+        for (int i = 0; i < jumps.continues.size(); ++i) {
+            patchJump(jumps.continues[i]);
+        }
+        if (e->increment != NULL) {
+            compile(e->increment);
+            emit(OP_POP);
+        }
+        emitLoop(loopStart);
+
+        patchJump(exitJump);
+        emit(OP_POP);
+        // break lands past the pop, its condition is already gone
+        for (int i = 0; i < jumps.breaks.size(); ++i) {
+            patchJump(jumps.breaks[i]);
+        }
+    }
+
+    void visitBreakStmt(Break* b) {
+        line = b->keyword.line;
+        leaveLoopScopes();
+        loops.back().breaks.push_back(emitJump(OP_JUMP));
+    }
+
+    void visitContinueStmt(Continue* c) {
+        line = c->keyword.line;
+        leaveLoopScopes();
+        loops.back().continues.push_back(emitJump(OP_JUMP));
+    }
+
+    void visitFunctionStmt(Function* e) {
+        line = e->fnName.line;
+        declaredCallables = true;
+        current->functions.push_back(compileFunction(e));
+        emitWithIndex(OP_FUNCTION, current->functions.size() - 1);
+        define(e->fnName);
+    }
+
+    void visitReturnStmt(Return* e) {
+        line = e->ret.line;
+        if (e->value != NULL) {
+            compile(e->value);
+        } else {
+            emit(OP_VOID);
+        }
+        emit(OP_RETURN);
+    }
+
+    void visitClassStmt(Class* c) {
+        line = c->name.line;
+        declaredCallables = true;
+        if (c->superclass != NULL) {
+            compile(c->superclass);
+        }
+
+        ClassProto* proto = new ClassProto(c);
+        for (int i = 0; c->methods.size() > i; ++i) {
+            proto->methods.push_back(compileFunction(c->methods[i]));
+        }
+        current->classes.push_back(proto);
+        line = c->name.line;
+        emitWithIndex(OP_CLASS, current->classes.size() - 1);
+    }
+
+    void visitAssignExpr(Assign* e) {
+        compile(e->value);
+        line = e->name.line;
+        emitVariable(e->local, e->name, OP_SET_LOCAL, OP_SET_GLOBAL);
+    }
+
+    void visitBinaryExpr(Binary* e) {
+        switch (e->op.type) {
+            case COMMA: {
+                compile(e->left);
+                emit(OP_POP);
+                compile(e->right);
+                return;
+            }
+            // a ? b : c is stored as Binary(a, ?, Binary(b, :, c))
+            case QUESTION_MARK: {
+                Binary* options = static_cast<Binary *>(e->right);
+                compile(e->left);
+                int elseJump = emitJump(OP_JUMP_IF_FALSE);
+                emit(OP_POP);
+                compile(options->left);
+                int endJump = emitJump(OP_JUMP);
+
+                patchJump(elseJump);
+                emit(OP_POP);
+                compile(options->right);
+                patchJump(endJump);
+                return;
+            }
+            default: {
+                break;
+            }
+        }
+
+        compile(e->left);
+        compile(e->right);
+        line = e->op.line;
+
+        switch (e->op.type) {
+            case GREATER: emit(OP_GREATER); break;
+            case GREATER_EQUAL: emit(OP_GREATER_EQUAL); break;
+            case LESS: emit(OP_LESS); break;
+            case LESS_EQUAL: emit(OP_LESS_EQUAL); break;
+            case NOT_EQUAL: emit(OP_NOT_EQUAL); break;
+            case EQUAL_EQUAL: emit(OP_EQUAL); break;
+            case PLUS: emit(OP_ADD); break;
+            case MINUS: emit(OP_SUBTRACT); break;
+            case MULT: emit(OP_MULTIPLY); break;
+            case SLASH: emit(OP_DIVIDE); break;
+            default: {
+                // operators without runtime support (like ^)
+                // produce no value, same as the Interpreter
+                emit(OP_POP);
+                emit(OP_POP);
+                emit(OP_VOID);
+                break;
+            }
+        }
+    }
+
+    void visitUnaryExpr(Unary* e) {
+        compile(e->right);
+        line = e->op.line;
+
+        switch (e->op.type) {
+            case NOT: emit(OP_NOT); break;
+            case MINUS: emit(OP_NEGATE); break;
+            default: {
+                emit(OP_POP);
+                emit(OP_VOID);
+                break;
+            }
+        }
+    }
+
+    void visitGroupingExpr(Grouping* e) {
+        compile(e->expr);
+    }
+
+    void visitBooleanExpr(Boolean* e) {
+        emitWithIndex(OP_CONSTANT, current->addBoolean(e->value));
+    }
+
+    void visitNumberExpr(Number* e) {
+        emitWithIndex(OP_CONSTANT, current->addNumber(e->value));
+    }
+
+    // string literals get their runtime string made once, here
+    // (once per chunk, however often the same text appears in it)
+    void visitStringExpr(String* e) {
+        emitWithIndex(OP_CONSTANT, current->addString(e->value));
+    }
+
+    void visitNilExpr(Nil* e) {
+        emit(OP_NIL);
+    }
+
+    void visitVariableExpr(Variable* e) {
+        line = e->name.line;
+        emitVariable(e->local, e->name, OP_GET_LOCAL, OP_GET_GLOBAL);
+    }
+
+    void visitLogicalExpr(Logical* e) {
+        compile(e->left);
+        // short circuit with the LHS as the result
+        int endJump = emitJump(e->op.type == OR ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE);
+        emit(OP_POP);
+        compile(e->right);
+        patchJump(endJump);
+    }
+
+    void visitCallExpr(Call* e) {
+        // obj.name(args) calls a method without binding it first
+        Get* g = e->callee->kind == NODE_GET ? static_cast<Get*>(e->callee) : NULL;
+        if (g != NULL) {
+            compile(g->object);
+            line = g->name.line;
+            current->gets.push_back(g);
+            emitWithIndex(OP_GET_METHOD, current->gets.size() - 1);
+        } else {
+            compile(e->callee);
+        }
+
+        for (int i = 0; i < e->arguments.size(); ++i) {
+            compile(e->arguments[i]);
+        }
+        line = e->rParen.line;
+        current->calls.push_back(e);
+        emitWithIndex(g != NULL ? OP_INVOKE : OP_CALL, e->arguments.size(), current->calls.size() - 1);
+    }
+
+    void visitGetExpr(Get* g) {
+        compile(g->object);
+        line = g->name.line;
+        current->gets.push_back(g);
+        emitWithIndex(OP_GET_PROPERTY, current->gets.size() - 1);
+    }
+
+    void visitSetExpr(Set* s) {
+        compile(s->object);
+        compile(s->value);
+        line = s->name.line;
+        current->sets.push_back(s);
+        emitWithIndex(OP_SET_PROPERTY, current->sets.size() - 1);
+    }
+
+    void visitThisExpr(This* t) {
+        line = t->keyword.line;
+        emitVariable(t->local, t->keyword, OP_GET_LOCAL, OP_GET_GLOBAL);
+    }
+
+    void visitSuperExpr(Super* s) {
+        line = s->keyword.line;
+        int depth = s->local.isGlobal() ? 0 : s->local.depth;
+
+        current->supers.push_back(s);
+        emitWithIndex(OP_GET_SUPER, depth, current->supers.size() - 1);
+    }
+
+    // some function or class was compiled. what the program makes
+    // of those runs their chunks, so they have to outlive the run
+    bool declaredCallables;
+
+private:
+    void compile(Stmt* s) {
+        visitStmt(s);
+    }
+
+    void compile(Expr* e) {
+        visitExpr(e);
+    }
+
+    // a chunk for fn, kept on chunks() till it is released
+    Chunk* newChunk(Function* fn=NULL) {
+        Chunk* chunk = new Chunk(fn);
+        chunks().push_back(chunk);
+        return chunk;
+    }
+
+    // resolved names are read from their slot in the scope chain,
+    // anything else is a global
+    void emitVariable(const LocalSlot& local, Token name, OpCode localOp, OpCode globalOp) {
+        if (local.isGlobal()) {
+            emitWithIndex(globalOp, current->addName(name));
+        } else {
+            emitWithOperand(localOp, local.depth);
+            writeOperand(local.slot);
+        }
+    }
+
+    // binds the value on top of the stack to a newly declared name
+    void define(Token name) {
+        if (scopeDepth == 0)
+            emitWithIndex(OP_DEFINE_GLOBAL, current->addName(name));
+        else
+            emit(OP_DEFINE_LOCAL);
+    }
+
+    // pops the scopes of the blocks a break or continue jumps out of
+    void leaveLoopScopes() {
+        for (int i = loops.back().scopeDepth; i < scopeDepth; ++i) {
+            emit(OP_POP_SCOPE);
+        }
+    }
+
+    void emit(uint8_t op) {
+        current->write(op, line);
+    }
+
+    void emitWithOperand(uint8_t op, int operand) {
+        emit(op);
+        writeOperand(operand);
+    }
+
+    // an operand that is a count, a depth or a slot
+    void writeOperand(int operand) {
+        if (operand > UINT16_MAX) {
+            handler->error(line, "Too many arguments, locals or nested scopes in one function.");
+        }
+        current->writeShort(operand, line);
+    }
+
+    // op with index (into the chunk's constants, names, functions,
+    // classes or sites) as its only operand
+    void emitWithIndex(uint8_t op, uint32_t index) {
+        emitWide(index);
+        emit(op);
+        current->writeShort(index & 0xffff, line);
+    }
+
+    // op with an operand ahead of its index (the argument count
+    // of a call, or the depth of a super)
+    void emitWithIndex(uint8_t op, int operand, uint32_t index) {
+        emitWide(index);
+        emitWithOperand(op, operand);
+        current->writeShort(index & 0xffff, line);
+    }
+
+    // the OP_WIDE an instruction needs ahead of it for index to fit
+    void emitWide(uint32_t index) {
+        if (index > UINT16_MAX) {
+            emit(OP_WIDE);
+            current->writeShort(index >> 16, line);
+        }
+    }
+
+    // emits a jump with a placeholder offset and
+    // returns where that offset lives so it can be patched
+    int emitJump(uint8_t op) {
+        emit(op);
+        current->writeInt(0xffffffff, line);
+        return current->code.size() - 4;
+    }
+
+    void patchJump(int offset) {
+        // -4 to adjust for the bytecode for the jump offset itself
+        uint32_t jump = current->code.size() - offset - 4;
+        current->code[offset] = (jump >> 24) & 0xff;
+        current->code[offset + 1] = (jump >> 16) & 0xff;
+        current->code[offset + 2] = (jump >> 8) & 0xff;
+        current->code[offset + 3] = jump & 0xff;
+    }
+
+    void emitLoop(int loopStart) {
+        emit(OP_LOOP);
+        current->writeInt(current->code.size() - loopStart + 4, line);
+    }
+
+    CInterpreter* interpreter;
+    ErrHandler* handler;
+    bool interacting;
+    Chunk* current;
+    int line; // line of the most recently compiled token
+    int scopeDepth; // 0 while compiling top level code
+    vector < LoopJumps > loops; // loops enclosing the code being compiled
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include "../AST/Expr.h"
+#include "../AST/Stmt.h"
+#include "../AST/Arena.h"
+#include "../Interpreter/Interpreter.h"
+
+using namespace std;
+
+// rewrites operations on literals into the literal they always produce,
+// once, after resolving and before either engine runs the program.
+// only what is certain to come out the same at runtime is folded: an
+// operation that would raise (a type error, or a division by zero) is
+// left for the runtime to raise when it is reached
+class ConstantFolder : public ExprVisitor<ConstantFolder, void>, public StmtVisitor<ConstantFolder, void> {
+public:
+    // new literals are made in arena, next to the tree they replace nodes of
+    ConstantFolder(Arena* arena) {
+        this->arena = arena;
+        replacement = NULL;
+        folded = 0;
+    }
+
+    void foldStmts(vector < Stmt* >& stmts) {
+        for (int i = 0; i < stmts.size(); ++i) {
+            fold(stmts[i]);
+        }
+    }
+
+    void visitExpressionStmt(Expression* e) {
+        fold(e->expr);
+    }
+
+    void visitPrintStmt(Print* p) {
+        fold(p->expr);
+    }
+
+    void visitVarStmt(Var* v) {
+        fold(v->initValue);
+    }
+
+    void visitBlockStmt(Block* b) {
+        foldStmts(b->stmts);
+    }
+
+    void visitIfStmt(If* i) {
+        fold(i->cond);
+        fold(i->then);
+        fold(i->else_);
+    }
+
+    void visitWhileStmt(While* w) {
+        fold(w->cond);
+        fold(w->body);
+        fold(w->increment);
+    }
+
+    void visitFunctionStmt(Function* f) {
+        // a lazily parsed body is folded when it is parsed
+        if (f->body != NULL)
+            foldStmts(f->body->stmts);
+    }
+
+    void visitReturnStmt(Return* r) {
+        fold(r->value);
+    }
+
+    void visitClassStmt(Class* c) {
+        for (int i = 0; i < c->methods.size(); ++i) {
+            visitFunctionStmt(c->methods[i]);
+        }
+    }
+
+    void visitBreakStmt(Break* b) { }
+
+    void visitContinueStmt(Continue* c) { }
+
+    void visitBinaryExpr(Binary* b) {
+        fold(b->left);
+
+        switch (b->op.type) {
+            // a ? b : c is stored as Binary(a, ?, Binary(b, :, c)),
+            // and only the chosen option is ever evaluated
+            case QUESTION_MARK: {
+                Binary* options = (Binary*) b->right;
+                fold(options->left);
+                fold(options->right);
+                if (isLiteral(b->left))
+                    replaceWith(isTruthyLiteral(b->left) ? options->left : options->right);
+                return;
+            }
+            // a literal on the left of a comma has no effect
+            case COMMA: {
+                fold(b->right);
+                if (isLiteral(b->left))
+                    replaceWith(b->right);
+                return;
+            }
+            default:
+                break;
+        }
+
+        fold(b->right);
+        if (!isLiteral(b->left) || !isLiteral(b->right))
+            return;
+
+        uint8_t lt = b->left->kind;
+        uint8_t rt = b->right->kind;
+        switch (b->op.type) {
+            case EQUAL_EQUAL: {
+                replaceWith(new (*arena) Boolean(literalsEqual(b->left, b->right)));
+                return;
+            }
+            case NOT_EQUAL: {
+                replaceWith(new (*arena) Boolean(!literalsEqual(b->left, b->right)));
+                return;
+            }
+            case PLUS: {
+                if (lt == NODE_STRING && rt == NODE_STRING) {
+                    string joined = ((String*) b->left)->value + ((String*) b->right)->value;
+                    replaceWith(new (*arena) String(joined));
+                    return;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        // the rest only take two numbers
+        if (lt != NODE_NUMBER || rt != NODE_NUMBER)
+            return;
+        double ln = ((Number*) b->left)->value;
+        double rn = ((Number*) b->right)->value;
+        switch (b->op.type) {
+            case GREATER: replaceWith(new (*arena) Boolean(ln > rn)); break;
+            case GREATER_EQUAL: replaceWith(new (*arena) Boolean(ln >= rn)); break;
+            case LESS: replaceWith(new (*arena) Boolean(ln < rn)); break;
+            case LESS_EQUAL: replaceWith(new (*arena) Boolean(ln <= rn)); break;
+            case PLUS: replaceWith(new (*arena) Number(ln + rn)); break;
+            case MINUS: replaceWith(new (*arena) Number(ln - rn)); break;
+            case MULT: replaceWith(new (*arena) Number(rn * ln)); break;
+            case SLASH: {
+                // dividing by zero still raises, when (and if) it runs
+                if (rn != 0)
+                    replaceWith(new (*arena) Number(ln / rn));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void visitUnaryExpr(Unary* u) {
+        fold(u->right);
+        if (!isLiteral(u->right))
+            return;
+
+        if (u->op.type == NOT)
+            replaceWith(new (*arena) Boolean(!isTruthyLiteral(u->right)));
+        else if (u->op.type == MINUS && u->right->kind == NODE_NUMBER)
+            replaceWith(new (*arena) Number(-((Number*) u->right)->value));
+    }
+
+    void visitGroupingExpr(Grouping* g) {
+        fold(g->expr);
+        if (isLiteral(g->expr))
+            replaceWith(g->expr);
+    }
+
+    void visitLogicalExpr(Logical* l) {
+        fold(l->left);
+        fold(l->right);
+        if (!isLiteral(l->left))
+            return;
+
+        // or keeps a truthy left side and and keeps a falsy one,
+        // otherwise the right side is the value
+        bool keepLeft = isTruthyLiteral(l->left) == (l->op.type == OR);
+        replaceWith(keepLeft ? l->left : l->right);
+    }
+
+    void visitAssignExpr(Assign* a) {
+        fold(a->value);
+    }
+
+    void visitCallExpr(Call* c) {
+        fold(c->callee);
+        for (int i = 0; i < c->arguments.size(); ++i) {
+            fold(c->arguments[i]);
+        }
+    }
+
+    void visitGetExpr(Get* g) {
+        fold(g->object);
+    }
+
+    void visitSetExpr(Set* s) {
+        fold(s->object);
+        fold(s->value);
+    }
+
+    void visitBooleanExpr(Boolean* b) { }
+    void visitNumberExpr(Number* n) { }
+    void visitStringExpr(String* s) { }
+    void visitNilExpr(Nil* n) { }
+    void visitVariableExpr(Variable* v) { }
+    void visitThisExpr(This* t) { }
+    void visitSuperExpr(Super* s) { }
+
+    int folded; // nodes replaced so far
+
+private:
+    // folds e in place: its visit sets replacement to
+    // whatever should stand where e did
+    void fold(Expr*& e) {
+        if (e == NULL)
+            return;
+        Expr* enclosing = replacement;
+        replacement = NULL;
+        visitExpr(e);
+        if (replacement != NULL) {
+            e = replacement;
+            folded++;
+        }
+        replacement = enclosing;
+    }
+
+    void fold(Stmt* s) {
+        if (s != NULL)
+            visitStmt(s);
+    }
+
+    void replaceWith(Expr* e) {
+        replacement = e;
+    }
+
+    static bool isLiteral(Expr* e) {
+        uint8_t k = e->kind;
+        return k == NODE_NUMBER || k == NODE_STRING || k == NODE_BOOLEAN || k == NODE_NIL;
+    }
+
+    // isTruthy, for a literal
+    static bool isTruthyLiteral(Expr* e) {
+        if (e->kind == NODE_STRING)
+            return ((String*) e)->value != "";
+        return isTruthy(literalValue(e));
+    }
+
+    // areEqual, for two literals
+    static bool literalsEqual(Expr* a, Expr* b) {
+        bool as = a->kind == NODE_STRING;
+        bool bs = b->kind == NODE_STRING;
+        if (as && bs)
+            return ((String*) a)->value == ((String*) b)->value;
+        if (as || bs)
+            return true; // areEqual has values of different types equal
+        return areEqual(literalValue(a), literalValue(b));
+    }
+
+    // the value of a literal other than a String, which would need
+    // a runtime object (and the folder never makes those)
+    static Value literalValue(Expr* e) {
+        switch (e->kind) {
+            case NODE_NUMBER: return Value::number(((Number*) e)->value);
+            case NODE_BOOLEAN: return Value::boolean(((Boolean*) e)->value);
+            default: return Value::nil();
+        }
+    }
+
+    Arena* arena;
+    Expr* replacement; // set by the visit of the node being folded
+};
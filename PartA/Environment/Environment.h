@@ -1,13 +1,18 @@
 #pragma once
 
 #include <iostream>
-#include <map>
+#include <unordered_map>
+#include <vector>
 #include "../AST/Expr.h"
 #include "../Helpers/ErrHandler.h"
+#include "../GC/Heap.h"
 
 using namespace std;
 
-class Environment {
+// globals and class environments (methods and fields) are looked
+// up by name, as interned Symbols. every other scope keeps its names in slots, in the
+// order they are declared, as numbered by the Resolver
+class Environment : public GcObject {
 public:
     Environment(ErrHandler* h, Environment* par=NULL, bool classEnv=false) {
         handler = h;
@@ -16,34 +21,36 @@ public:
     }
 
     // defining an identifier in the current scope
-    void define(string name, Storable* val) {
-        if (find(name) != NULL) // allow redefinition and shadowing
-            stored.erase(name);
-
-        stored.insert(pair<string, Storable* >(name, val));
+    void define(Symbol name, Value val) {
+        stored[name] = val; // allow redefinition and shadowing
     }
 
     // for identifier reference
-    Storable* get(Token key) {
-        Storable* found = find(key.lexeme);
+    Value get(Token key) {
+        Value* found = find(key.symbol);
 
         if (found != NULL)
-            return found;
+            return *found;
 
         if (parent != NULL)
             return parent->get(key); // check nested Environments
 
         if (isClassEnv) {
-            throw RuntimeError(key, "Undefined property reference '" + key.lexeme + "'.");
+            throw RuntimeError(key, "Undefined property reference '" + key.lexeme() + "'.");
         }
         else {
-            throw RuntimeError(key, "Undefined variable reference '" + key.lexeme + "'.");
+            throw RuntimeError(key, "Undefined variable reference '" + key.lexeme() + "'.");
         }
     }
 
-    Storable* getAtDepth(int distance, Token name) {
-        // cout << "finding at " << distance << " for " << name.lexeme << endl;
-        return visitAncestor(distance)->get(name);
+    // declarations inside local scopes run in the same order the
+    // Resolver numbered them, so a new name takes the next slot
+    void defineSlot(Value val) {
+        slots.push_back(val);
+    }
+
+    Value getAt(int distance, int slot) {
+        return visitAncestor(distance)->slots[slot];
     }
 
     Environment* visitAncestor(int distance) {
@@ -57,12 +64,11 @@ public:
     }
 
     // for changing the value of a name, as long as it exists
-    void assign(Token key, Storable* val) {
-        Storable* found = find(key.lexeme);
+    void assign(Token key, Value val) {
+        Value* found = find(key.symbol);
 
         if (found != NULL) {
-            stored.erase(key.lexeme);
-            stored.insert(pair<string, Storable*>(key.lexeme, val));
+            *found = val;
             return;
         } 
 
@@ -72,26 +78,39 @@ public:
         }
         
         if (isClassEnv)
-            throw RuntimeError(key, "Undefined property reference '" + key.lexeme + "'.");
+            throw RuntimeError(key, "Undefined property reference '" + key.lexeme() + "'.");
         else
-            throw RuntimeError(key, "Undefined variable reference '" + key.lexeme + "'.");
+            throw RuntimeError(key, "Undefined variable reference '" + key.lexeme() + "'.");
     }
 
-    void assignAtDepth(int distance, Token key, Storable* value) {
-        visitAncestor(distance)->assign(key, value);
+    void assignAt(int distance, int slot, Value value) {
+        visitAncestor(distance)->slots[slot] = value;
     }
 
-    Storable* find(string name) {
-        map < string, Storable* >::iterator loc = stored.find(name);
+    // the stored value for name in this scope alone,
+    // or NULL when it is not defined here
+    Value* find(Symbol name) {
+        unordered_map < Symbol, Value >::iterator loc = stored.find(name);
 
         if (loc != stored.end()) 
-            return loc->second;
+            return &loc->second;
 
         return NULL;            
     }
 
+    void trace() {
+        heap().mark(parent);
+        for (unordered_map < Symbol, Value >::iterator it = stored.begin(); it != stored.end(); ++it) {
+            markValue(it->second);
+        }
+        for (int i = 0; i < slots.size(); ++i) {
+            markValue(slots[i]);
+        }
+    }
+
     ErrHandler* handler;
-    map < string, Storable* > stored;
+    unordered_map < Symbol, Value > stored;
+    vector < Value > slots;
     Environment* parent;
     bool isClassEnv;
 };
\ No newline at end of file
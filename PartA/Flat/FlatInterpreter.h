@@ -0,0 +1,353 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include "FlatTree.h"
+#include "../AST/Completion.h"
+#include "../Interpreter/Interpreter.h"
+
+using namespace std;
+
+// runs a program off its FlatTree, with one switch over the node
+// kind in place of a virtual visit per node. everything past the
+// tree (values, scopes, functions, classes, caches) is shared with the
+// tree-walker, so the two behave (and report errors) the same
+class FlatInterpreter : public CInterpreter {
+public:
+    FlatInterpreter(ErrHandler* e, bool interactiveMode=false, Environment* globals=NULL) : flattener(&tree) {
+        handler = e;
+        interacting = interactiveMode;
+
+        if (globals)
+            env = globals;
+        else
+            env = new Environment(e);
+
+        env->define(intern("clock"), Value::object(new Clock()));
+        this->globals = env;
+    }
+
+    ~FlatInterpreter() {
+        flatStats().bytes += tree.bytes();
+    }
+
+    void interpret(vector < Stmt* > stmts) {
+        vector < NodeId > flat = flattener.stmts(stmts);
+        int mark = heap().temps.size();
+        try {
+            for (int i = 0; i < flat.size(); ++i) {
+                execute(flat[i]);
+            }
+        } catch (RuntimeError& err) {
+            heap().temps.resize(mark);
+            handler->runtimeError(err);
+        }
+    }
+
+    Value executeBody(Block* body, Environment* scope) {
+        return bodyResult(executeBlock(flattener.body(body), scope));
+    }
+
+    // the value of the expression at n. the common kinds are handled
+    // right here, and the rest in functions of their own, which keeps
+    // this (the one function every expression goes through) small
+    Value eval(NodeId n) {
+        switch (tree.kind[n]) {
+            case FLAT_NUMBER:
+                return Value::number(tree.numbers[tree.a[n]]);
+            case FLAT_STRING:
+                return Value::object(new CroixString(tree.strings[tree.a[n]]));
+            case FLAT_TRUE:
+                return Value::boolean(true);
+            case FLAT_FALSE:
+                return Value::boolean(false);
+            case FLAT_NIL:
+                return Value::nil();
+
+            case FLAT_LOCAL:
+                return env->getAt(tree.a[n], tree.b[n]);
+            case FLAT_GLOBAL:
+                return globals->get(token(n));
+            case FLAT_ASSIGN_LOCAL: {
+                Value v = eval(tree.a[n]);
+                env->assignAt(tree.b[n], tree.c[n], v);
+                return v;
+            }
+            case FLAT_ASSIGN_GLOBAL: {
+                Value v = eval(tree.a[n]);
+                globals->assign(token(n), v);
+                return v;
+            }
+
+            case FLAT_ADD: case FLAT_SUBTRACT: case FLAT_MULTIPLY: case FLAT_DIVIDE:
+            case FLAT_GREATER: case FLAT_GREATER_EQUAL: case FLAT_LESS: case FLAT_LESS_EQUAL:
+            case FLAT_EQUAL: case FLAT_NOT_EQUAL: case FLAT_NO_VALUE:
+                return binary(n);
+            case FLAT_COMMA: {
+                eval(tree.a[n]);
+                return eval(tree.b[n]);
+            }
+            case FLAT_AND: {
+                Value lhs = eval(tree.a[n]);
+                if (!isTruthy(lhs))
+                    return lhs;
+                return eval(tree.b[n]);
+            }
+            case FLAT_OR: {
+                Value lhs = eval(tree.a[n]);
+                if (isTruthy(lhs))
+                    return lhs;
+                return eval(tree.b[n]);
+            }
+            case FLAT_TERNARY: {
+                if (isTruthy(eval(tree.a[n])))
+                    return eval(tree.b[n]);
+                return eval(tree.c[n]);
+            }
+
+            case FLAT_NEGATE: {
+                Value r = eval(tree.a[n]);
+                if (!isN(r))
+                    isNumber(token(n), r);
+                return Value::number(-r.asNumber());
+            }
+            case FLAT_NOT:
+                return Value::boolean(!isTruthy(eval(tree.a[n])));
+
+            case FLAT_CALL:
+                return call(n, eval(tree.a[n]));
+            case FLAT_INVOKE:
+                return invoke(n);
+            case FLAT_GET:
+                return get(n);
+            case FLAT_SET:
+                return set(n);
+            case FLAT_SUPER:
+                return super(n);
+
+            default:
+                return Value();
+        }
+    }
+
+    Completion execute(NodeId n) {
+        collectIfNeeded();
+
+        switch (tree.kind[n]) {
+            case FLAT_EXPRESSION: {
+                if (interacting)
+                    showValue(eval(tree.a[n]));
+                else
+                    eval(tree.a[n]);
+                return NORMAL_COMPLETION;
+            }
+            case FLAT_PRINT: {
+                if (tree.a[n] != NO_NODE)
+                    printStored(this, eval(tree.a[n]));
+                else
+                    cout << endl;
+                return NORMAL_COMPLETION;
+            }
+            case FLAT_VAR: {
+                Value v = Value::nil();
+                if (tree.a[n] != NO_NODE)
+                    v = eval(tree.a[n]);
+                define(tree.b[n], v);
+                return NORMAL_COMPLETION;
+            }
+            case FLAT_BLOCK:
+                return executeBlock(n, new Environment(handler, env));
+            case FLAT_IF: {
+                if (isTruthy(eval(tree.a[n])))
+                    return execute(tree.b[n]);
+                else if (tree.c[n] != NO_NODE)
+                    return execute(tree.c[n]);
+                return NORMAL_COMPLETION;
+            }
+            case FLAT_WHILE: {
+                while (isTruthy(eval(tree.a[n]))) {
+                    Completion done = execute(tree.b[n]);
+                    if (done == BREAK_COMPLETION)
+                        break;
+                    if (done == RETURN_COMPLETION)
+                        return done;
+
+                    // continue still runs the increment of a for loop
+                    if (tree.c[n] != NO_NODE)
+                        eval(tree.c[n]);
+                }
+                return NORMAL_COMPLETION;
+            }
+            case FLAT_FUNCTION: {
+                Function* decl = tree.functions[tree.a[n]];
+                define(decl->fnName.symbol, Value::object(new UserFunction(decl, env)));
+                return NORMAL_COMPLETION;
+            }
+            case FLAT_RETURN: {
+                Value rVal;
+                if (tree.a[n] != NO_NODE)
+                    rVal = eval(tree.a[n]);
+
+                // picked up by executeBody once the blocks in between unwind
+                returned = rVal;
+                return RETURN_COMPLETION;
+            }
+            case FLAT_CLASS:
+                return executeClass(n);
+            case FLAT_BREAK:
+                return BREAK_COMPLETION;
+            case FLAT_CONTINUE:
+                return CONTINUE_COMPLETION;
+            default:
+                return NORMAL_COMPLETION;
+        }
+    }
+
+private:
+    Token token(NodeId n) {
+        return tree.tokens[tree.token[n]].token();
+    }
+
+    // the value of the binary operator at n, with
+    // both sides evaluated in order
+    Value binary(NodeId n) {
+        Value l = eval(tree.a[n]);
+        Value r;
+        // only an object on the left needs keeping alive meanwhile
+        if (l.isObject()) {
+            protect(l);
+            r = eval(tree.b[n]);
+            heap().pop();
+        } else {
+            r = eval(tree.b[n]);
+        }
+
+        uint8_t k = tree.kind[n];
+        switch (k) {
+            case FLAT_EQUAL:
+                return Value::boolean(areEqual(l, r));
+            case FLAT_NOT_EQUAL:
+                return Value::boolean(!areEqual(l, r));
+            case FLAT_NO_VALUE:
+                return Value();
+            case FLAT_ADD:
+                if (isStr(l) && isStr(r))
+                    return Value::object(new CroixString(l.asString()->value + r.asString()->value));
+                if (!isN(l) || !isN(r))
+                    areNumbersOrStrings(token(n), l, r);
+                break;
+            default:
+                // the token is only looked up when there is an error to raise
+                if (!isN(l) || !isN(r))
+                    areNumbers(token(n), l, r);
+                break;
+        }
+
+        double ln = l.asNumber();
+        double rn = r.asNumber();
+        switch (k) {
+            case FLAT_ADD: return Value::number(ln + rn);
+            case FLAT_SUBTRACT: return Value::number(ln - rn);
+            case FLAT_MULTIPLY: return Value::number(rn * ln);
+            case FLAT_DIVIDE: {
+                if (rn == 0)
+                    throw RuntimeError(token(n), "Division by Zero.");
+                return Value::number(ln / rn);
+            }
+            case FLAT_GREATER: return Value::boolean(ln > rn);
+            case FLAT_GREATER_EQUAL: return Value::boolean(ln >= rn);
+            case FLAT_LESS: return Value::boolean(ln < rn);
+            default: return Value::boolean(ln <= rn);
+        }
+    }
+
+    // obj.name(args), calling the method straight on obj
+    Value invoke(NodeId n) {
+        NodeId get = tree.a[n];
+        Value receiver = eval(tree.a[get]);
+        CroixClass::CroixClassInstance* inst = asInstance(receiver);
+
+        if (inst == NULL)
+            throw RuntimeError(token(get), "Only class instances have properties.");
+
+        UserFunction* method;
+        Value callee = inst->lookup(token(get), tree.properties[tree.c[get]], method);
+        if (method != NULL)
+            return invoke(n, method, receiver);
+        return call(n, inst->rebind(callee));
+    }
+
+    Value get(NodeId n) {
+        CroixClass::CroixClassInstance* inst = asInstance(eval(tree.a[n]));
+
+        if (inst == NULL)
+            throw RuntimeError(token(n), "Only class instances have properties.");
+        return inst->get(token(n), tree.properties[tree.c[n]]);
+    }
+
+    Value set(NodeId n) {
+        CroixClass::CroixClassInstance* inst = asInstance(eval(tree.a[n]));
+
+        if (inst == NULL)
+            throw RuntimeError(token(n), "Only class instances have properties.");
+        heap().push(inst);
+        Value newVal = eval(tree.b[n]);
+        heap().pop();
+        inst->set(token(n), newVal, tree.properties[tree.c[n]]);
+        return newVal;
+    }
+
+    Value super(NodeId n) {
+        // "super" is alone in its scope, and "this" takes
+        // the first slot of the method's scope inside it
+        int depth = tree.a[n];
+        CroixClass* superclass = (CroixClass*) env->getAt(depth, 0).asObject();
+        Value child = env->getAt(depth - 1, 0);
+
+        UserFunction* method = superclass->findMethod(token(n), tree.properties[tree.c[n]]);
+        return Value::object(method->bind(child));
+    }
+
+    // calls callee with the arguments of the call at n
+    Value call(NodeId n, Value callee) {
+        vector < Value > args;
+        protect(callee);
+        arguments(n, args);
+        return finishCall(this, token(n), tree.calls[tree.c[n]], callee, args);
+    }
+
+    // calls method with receiver as "this", without
+    // making a BoundMethod for the pair
+    Value invoke(NodeId n, UserFunction* method, Value receiver) {
+        vector < Value > args;
+        protect(receiver);
+        arguments(n, args);
+        return finishInvoke(this, token(n), method, receiver, args);
+    }
+
+    // evaluates (and protects) the arguments of the call at n
+    void arguments(NodeId n, vector < Value >& args) {
+        uint32_t at = tree.b[n];
+        uint32_t count = tree.lists[at];
+        for (uint32_t i = 1; i <= count; ++i) {
+            args.push_back(eval(tree.lists[at + i]));
+            protect(args.back());
+        }
+    }
+
+    // kept out of execute's switch, which every statement goes through
+    __attribute__((noinline)) Completion executeClass(NodeId n) {
+        Value super;
+        if (tree.a[n] != NO_NODE)
+            super = eval(tree.a[n]);
+        declareClass(this, tree.classes[tree.b[n]], super);
+        return NORMAL_COMPLETION;
+    }
+
+    Completion executeBlock(NodeId block, Environment* scope) {
+        return executeIn(this, FlatBlock(&tree, block), scope);
+    }
+
+    FlatTree tree;
+    Flattener flattener;
+};
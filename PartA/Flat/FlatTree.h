@@ -0,0 +1,555 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <stdint.h>
+#include "../AST/Expr.h"
+#include "../AST/Stmt.h"
+#include "../AST/InlineCache.h"
+#include "../AST/CInterpreter.h"
+
+using namespace std;
+
+// a node of a FlatTree, by its place in the tree's columns
+typedef uint32_t NodeId;
+
+// node 0 of every flat tree is no node (like a missing else)
+const NodeId NO_NODE = 0;
+
+// what a flat node is. operators get a kind each, so the evaluator
+// switches once per node instead of again on a token type.
+// what a, b and c hold for each kind is noted next to it
+enum FlatKind {
+    FLAT_NONE,
+
+    // literals
+    FLAT_NUMBER, // a: number
+    FLAT_STRING, // a: string
+    FLAT_TRUE, FLAT_FALSE, FLAT_NIL,
+
+    // names, resolved to a slot or left to the globals (by token)
+    FLAT_LOCAL, // a: depth, b: slot
+    FLAT_GLOBAL,
+    FLAT_ASSIGN_LOCAL, // a: value, b: depth, c: slot
+    FLAT_ASSIGN_GLOBAL, // a: value
+
+    // a: left, b: right, and the operator's token for errors
+    FLAT_ADD, FLAT_SUBTRACT, FLAT_MULTIPLY, FLAT_DIVIDE,
+    FLAT_GREATER, FLAT_GREATER_EQUAL, FLAT_LESS, FLAT_LESS_EQUAL,
+    FLAT_EQUAL, FLAT_NOT_EQUAL,
+    FLAT_NO_VALUE, // an operator with no meaning (^): both sides, then no value
+    FLAT_COMMA,
+    FLAT_AND, FLAT_OR,
+    FLAT_TERNARY, // a: condition, b: then, c: else
+
+    FLAT_NEGATE, FLAT_NOT, // a: operand
+
+    FLAT_CALL, // a: callee, b: arguments list, c: call cache
+    FLAT_INVOKE, // as FLAT_CALL, with a FLAT_GET as the callee
+    FLAT_GET, // a: object, c: property cache
+    FLAT_SET, // a: object, b: value, c: property cache
+    FLAT_SUPER, // a: depth, c: property cache
+
+    // statements
+    FLAT_EXPRESSION, // a: expression
+    FLAT_PRINT, // a: expression, or none for an empty line
+    FLAT_VAR, // a: initial value, b: name's symbol
+    FLAT_BLOCK, // b: statements list
+    FLAT_IF, // a: condition, b: then, c: else
+    FLAT_WHILE, // a: condition, b: body, c: increment
+    FLAT_FUNCTION, // a: function
+    FLAT_RETURN, // a: value
+    FLAT_CLASS, // a: superclass, b: class
+    FLAT_BREAK, FLAT_CONTINUE
+};
+
+// what running a program still needs of a token: its name, and its
+// lexeme and line for errors. its type and column aren't kept, as
+// nothing past the resolver looks at them
+class FlatToken {
+public:
+    FlatToken(const Token& t) {
+        offset = t.offset;
+        length = t.length;
+        line = t.line;
+        symbol = t.symbol;
+    }
+
+    Token token() const {
+        Token t(IDENTIFIER, offset, length, line);
+        t.symbol = symbol;
+        return t;
+    }
+
+    uint32_t offset;
+    uint32_t length;
+    int line;
+    Symbol symbol;
+};
+
+// a resolved syntax tree held in columns, one entry per node, with
+// nodes referring to each other by NodeId instead of by pointer. what
+// doesn't fit in a column (lexemes, literals, caches, lists of
+// children) is kept once in a side table and referred to by index.
+// nodes are laid out in preorder, so walking a function reads its
+// columns front to back
+class FlatTree {
+public:
+    FlatTree() {
+        tokens.push_back(FlatToken(Token())); // token 0 is none, as node 0 is
+        add(FLAT_NONE);
+    }
+
+    NodeId add(FlatKind k, uint32_t tokenAt=0) {
+        kind.push_back(k);
+        a.push_back(0);
+        b.push_back(0);
+        c.push_back(0);
+        token.push_back(tokenAt);
+        return kind.size() - 1;
+    }
+
+    // gives back what the columns and tables hold past their size,
+    // once a whole script is in
+    void shrink() {
+        kind.shrink_to_fit();
+        a.shrink_to_fit();
+        b.shrink_to_fit();
+        c.shrink_to_fit();
+        token.shrink_to_fit();
+        lists.shrink_to_fit();
+        tokens.shrink_to_fit();
+        numbers.shrink_to_fit();
+        strings.shrink_to_fit();
+        functions.shrink_to_fit();
+        classes.shrink_to_fit();
+        properties.shrink_to_fit();
+        calls.shrink_to_fit();
+    }
+
+    // the size of every column and table, as held
+    size_t bytes() {
+        size_t size = kind.capacity() * sizeof(uint8_t);
+        size += (a.capacity() + b.capacity() + c.capacity() + token.capacity()) * sizeof(uint32_t);
+        size += lists.capacity() * sizeof(uint32_t);
+        size += tokens.capacity() * sizeof(FlatToken);
+        size += numbers.capacity() * sizeof(double);
+        for (int i = 0; i < strings.size(); ++i) {
+            size += sizeof(string) + strings[i].capacity();
+        }
+        size += (functions.capacity() + classes.capacity()) * sizeof(void*);
+        size += properties.capacity() * sizeof(PropertyCache);
+        size += calls.capacity() * sizeof(CallCache);
+        size += bodies.size() * (sizeof(Block*) + sizeof(NodeId) + sizeof(void*));
+        size += bodies.bucket_count() * sizeof(void*);
+        return size;
+    }
+
+    // the columns
+    vector < uint8_t > kind;
+    vector < uint32_t > a, b, c;
+    vector < uint32_t > token; // where the node's token is in tokens, if it has one
+
+    // lists of children, each as its length and then the children
+    vector < uint32_t > lists;
+    vector < FlatToken > tokens;
+    vector < double > numbers;
+    vector < string > strings;
+    // declarations, which the runtime's functions and classes point back to
+    vector < Function* > functions;
+    vector < Class* > classes;
+    vector < PropertyCache > properties;
+    vector < CallCache > calls;
+
+    // every function body flattened so far, by the block it came from
+    unordered_map < Block*, NodeId > bodies;
+};
+
+// the statements of a flattened block, read out of the lists table
+// on every access: flattening a body on its first call can move it
+class FlatBlock {
+public:
+    FlatBlock(FlatTree* t, NodeId block) {
+        tree = t;
+        at = t->b[block];
+    }
+
+    uint32_t size() const {
+        return tree->lists[at];
+    }
+
+    NodeId operator[](uint32_t i) const {
+        return tree->lists[at + 1 + i];
+    }
+
+private:
+    FlatTree* tree;
+    uint32_t at;
+};
+
+// running totals for --parse-stats: the nodes flattened, and
+// the syntax tree nodes they were flattened from
+class FlatStats {
+public:
+    FlatStats() {
+        nodes = 0;
+        bytes = 0;
+        treeNodes = 0;
+        treeBytes = 0;
+    }
+
+    void report() {
+        cout << "[flat] " << nodes << " nodes in " << bytes << " bytes (" << perNode(bytes, nodes);
+        cout << " per node), from " << treeNodes << " syntax tree nodes in " << treeBytes;
+        cout << " bytes (" << perNode(treeBytes, treeNodes) << " per node)" << endl;
+    }
+
+    size_t nodes;
+    size_t bytes; // of the flat trees, counted as each one goes
+    size_t treeNodes;
+    size_t treeBytes; // the nodes themselves, and the vectors and strings they own
+
+private:
+    static double perNode(size_t bytes, size_t nodes) {
+        return nodes == 0 ? 0 : (double) bytes / nodes;
+    }
+};
+
+FlatStats& flatStats() {
+    static FlatStats stats;
+    return stats;
+}
+
+// adds a resolved (and folded) syntax tree to a FlatTree. the depths
+// and slots the resolver worked out are copied off the nodes, so what
+// is flattened holds everything needed to run it. groupings are left
+// out, since they only ever stood for what they group
+class Flattener : public ExprVisitor<Flattener, void>, public StmtVisitor<Flattener, void> {
+public:
+    Flattener(FlatTree* tree) {
+        this->tree = tree;
+        made = NO_NODE;
+    }
+
+    NodeId expr(Expr* e) {
+        if (e == NULL)
+            return NO_NODE;
+        NodeId enclosing = made;
+        visitExpr(e);
+        NodeId n = made;
+        made = enclosing;
+        return n;
+    }
+
+    NodeId stmt(Stmt* s) {
+        if (s == NULL)
+            return NO_NODE;
+        NodeId enclosing = made;
+        visitStmt(s);
+        NodeId n = made;
+        made = enclosing;
+        return n;
+    }
+
+    // the flattened body of a function, flattening it the first time
+    NodeId body(Block* b) {
+        unordered_map < Block*, NodeId >::iterator found = tree->bodies.find(b);
+        if (found != tree->bodies.end())
+            return found->second;
+
+        NodeId n = stmt(b);
+        tree->bodies.insert(make_pair(b, n));
+        return n;
+    }
+
+    // flattens the statements of a script (or REPL line)
+    vector < NodeId > stmts(vector < Stmt* >& stmts) {
+        vector < NodeId > flat;
+        for (int i = 0; i < stmts.size(); ++i) {
+            flat.push_back(stmt(stmts[i]));
+        }
+        tree->shrink();
+        return flat;
+    }
+
+    void visitExpressionStmt(Expression* e) {
+        counted(sizeof(*e));
+        NodeId n = add(FLAT_EXPRESSION);
+        set(tree->a, n, expr(e->expr));
+    }
+
+    void visitPrintStmt(Print* p) {
+        counted(sizeof(*p));
+        NodeId n = add(FLAT_PRINT);
+        set(tree->a, n, expr(p->expr));
+    }
+
+    void visitVarStmt(Var* v) {
+        counted(sizeof(*v));
+        NodeId n = add(FLAT_VAR);
+        set(tree->a, n, expr(v->initValue));
+        tree->b[n] = v->name.symbol;
+    }
+
+    void visitBlockStmt(Block* b) {
+        counted(sizeof(*b) + b->stmts.capacity() * sizeof(Stmt*));
+        NodeId n = add(FLAT_BLOCK);
+        vector < NodeId > children;
+        for (int i = 0; i < b->stmts.size(); ++i) {
+            children.push_back(stmt(b->stmts[i]));
+        }
+        set(tree->b, n, list(children));
+    }
+
+    void visitIfStmt(If* i) {
+        counted(sizeof(*i));
+        NodeId n = add(FLAT_IF);
+        set(tree->a, n, expr(i->cond));
+        set(tree->b, n, stmt(i->then));
+        set(tree->c, n, stmt(i->else_));
+    }
+
+    void visitWhileStmt(While* w) {
+        counted(sizeof(*w));
+        NodeId n = add(FLAT_WHILE);
+        set(tree->a, n, expr(w->cond));
+        set(tree->b, n, stmt(w->body));
+        set(tree->c, n, expr(w->increment));
+    }
+
+    void visitFunctionStmt(Function* f) {
+        counted(sizeof(*f) + f->params.capacity() * sizeof(Token));
+        NodeId n = add(FLAT_FUNCTION);
+        tree->a[n] = tree->functions.size();
+        tree->functions.push_back(f);
+        // a body parsed lazily is flattened when it is parsed
+        if (f->body != NULL)
+            body(f->body);
+    }
+
+    void visitReturnStmt(Return* r) {
+        counted(sizeof(*r));
+        NodeId n = add(FLAT_RETURN);
+        set(tree->a, n, expr(r->value));
+    }
+
+    void visitClassStmt(Class* c) {
+        counted(sizeof(*c) + c->methods.capacity() * sizeof(Function*));
+        NodeId n = add(FLAT_CLASS);
+        set(tree->a, n, expr(c->superclass));
+        tree->b[n] = tree->classes.size();
+        tree->classes.push_back(c);
+        for (int i = 0; i < c->methods.size(); ++i) {
+            Function* m = c->methods[i];
+            counted(sizeof(*m) + m->params.capacity() * sizeof(Token));
+            if (m->body != NULL)
+                body(m->body);
+        }
+    }
+
+    void visitBreakStmt(Break* b) {
+        counted(sizeof(*b));
+        add(FLAT_BREAK);
+    }
+
+    void visitContinueStmt(Continue* c) {
+        counted(sizeof(*c));
+        add(FLAT_CONTINUE);
+    }
+
+    void visitAssignExpr(Assign* a) {
+        counted(sizeof(*a));
+        if (a->local.isGlobal()) {
+            NodeId n = add(FLAT_ASSIGN_GLOBAL, a->name);
+            set(tree->a, n, expr(a->value));
+        } else {
+            NodeId n = add(FLAT_ASSIGN_LOCAL);
+            set(tree->a, n, expr(a->value));
+            tree->b[n] = a->local.depth;
+            tree->c[n] = a->local.slot;
+        }
+    }
+
+    void visitBinaryExpr(Binary* b) {
+        counted(sizeof(*b));
+        // a ? b : c is stored as Binary(a, ?, Binary(b, :, c))
+        if (b->op.type == QUESTION_MARK) {
+            Binary* options = (Binary*) b->right;
+            counted(sizeof(*options));
+            NodeId n = add(FLAT_TERNARY);
+            set(tree->a, n, expr(b->left));
+            set(tree->b, n, expr(options->left));
+            set(tree->c, n, expr(options->right));
+            return;
+        }
+
+        NodeId n = add(binaryKind(b->op.type), b->op);
+        set(tree->a, n, expr(b->left));
+        set(tree->b, n, expr(b->right));
+    }
+
+    void visitUnaryExpr(Unary* u) {
+        counted(sizeof(*u));
+        NodeId n = add(u->op.type == NOT ? FLAT_NOT : FLAT_NEGATE, u->op);
+        set(tree->a, n, expr(u->right));
+    }
+
+    void visitGroupingExpr(Grouping* g) {
+        counted(sizeof(*g));
+        made = expr(g->expr);
+    }
+
+    void visitBooleanExpr(Boolean* b) {
+        counted(sizeof(*b));
+        add(b->value ? FLAT_TRUE : FLAT_FALSE);
+    }
+
+    void visitNumberExpr(Number* n) {
+        counted(sizeof(*n));
+        NodeId at = add(FLAT_NUMBER);
+        tree->a[at] = tree->numbers.size();
+        tree->numbers.push_back(n->value);
+    }
+
+    void visitStringExpr(String* s) {
+        counted(sizeof(*s) + s->value.capacity());
+        NodeId n = add(FLAT_STRING);
+        tree->a[n] = tree->strings.size();
+        tree->strings.push_back(s->value);
+    }
+
+    void visitNilExpr(Nil* n) {
+        counted(sizeof(*n));
+        add(FLAT_NIL);
+    }
+
+    void visitVariableExpr(Variable* v) {
+        counted(sizeof(*v));
+        name(v->local, v->name);
+    }
+
+    void visitLogicalExpr(Logical* l) {
+        counted(sizeof(*l));
+        NodeId n = add(l->op.type == OR ? FLAT_OR : FLAT_AND);
+        set(tree->a, n, expr(l->left));
+        set(tree->b, n, expr(l->right));
+    }
+
+    void visitCallExpr(Call* c) {
+        counted(sizeof(*c) + c->arguments.capacity() * sizeof(Expr*));
+        // obj.name(args) calls a method straight on obj
+        bool invoke = c->callee->kind == NODE_GET;
+        NodeId n = add(invoke ? FLAT_INVOKE : FLAT_CALL, c->rParen);
+        set(tree->a, n, expr(c->callee));
+        vector < NodeId > arguments;
+        for (int i = 0; i < c->arguments.size(); ++i) {
+            arguments.push_back(expr(c->arguments[i]));
+        }
+        set(tree->b, n, list(arguments));
+        tree->c[n] = tree->calls.size();
+        tree->calls.push_back(CallCache());
+    }
+
+    void visitGetExpr(Get* g) {
+        counted(sizeof(*g));
+        NodeId n = add(FLAT_GET, g->name);
+        set(tree->a, n, expr(g->object));
+        set(tree->c, n, property());
+    }
+
+    void visitSetExpr(Set* s) {
+        counted(sizeof(*s));
+        NodeId n = add(FLAT_SET, s->name);
+        set(tree->a, n, expr(s->object));
+        set(tree->b, n, expr(s->value));
+        set(tree->c, n, property());
+    }
+
+    void visitThisExpr(This* t) {
+        counted(sizeof(*t));
+        name(t->local, t->keyword);
+    }
+
+    void visitSuperExpr(Super* s) {
+        counted(sizeof(*s));
+        NodeId n = add(FLAT_SUPER, s->property);
+        // as the tree-walker does, a super the resolver missed is at depth 0
+        if (!s->local.isGlobal())
+            tree->a[n] = s->local.depth;
+        set(tree->c, n, property());
+    }
+
+private:
+    NodeId add(FlatKind k) {
+        made = tree->add(k);
+        flatStats().nodes++;
+        return made;
+    }
+
+    // a node that keeps t, for its name or for the errors it raises
+    NodeId add(FlatKind k, const Token& t) {
+        tree->tokens.push_back(FlatToken(t));
+        made = tree->add(k, tree->tokens.size() - 1);
+        flatStats().nodes++;
+        return made;
+    }
+
+    // sets a field of node n. the value is passed in, so it is worked
+    // out before the column is indexed: flattening it can move the column
+    void set(vector < uint32_t >& field, NodeId n, uint32_t value) {
+        field[n] = value;
+    }
+
+    // a variable (or this), in the slot the resolver gave it
+    // or by name when it was left to the globals
+    void name(const LocalSlot& local, const Token& t) {
+        if (local.isGlobal()) {
+            add(FLAT_GLOBAL, t);
+        } else {
+            NodeId n = add(FLAT_LOCAL);
+            tree->a[n] = local.depth;
+            tree->b[n] = local.slot;
+        }
+    }
+
+    // where children are in the lists table
+    uint32_t list(const vector < NodeId >& children) {
+        uint32_t at = tree->lists.size();
+        tree->lists.push_back(children.size());
+        tree->lists.insert(tree->lists.end(), children.begin(), children.end());
+        return at;
+    }
+
+    uint32_t property() {
+        tree->properties.push_back(PropertyCache());
+        return tree->properties.size() - 1;
+    }
+
+    static FlatKind binaryKind(TokenType op) {
+        switch (op) {
+            case PLUS: return FLAT_ADD;
+            case MINUS: return FLAT_SUBTRACT;
+            case MULT: return FLAT_MULTIPLY;
+            case SLASH: return FLAT_DIVIDE;
+            case GREATER: return FLAT_GREATER;
+            case GREATER_EQUAL: return FLAT_GREATER_EQUAL;
+            case LESS: return FLAT_LESS;
+            case LESS_EQUAL: return FLAT_LESS_EQUAL;
+            case EQUAL_EQUAL: return FLAT_EQUAL;
+            case NOT_EQUAL: return FLAT_NOT_EQUAL;
+            case COMMA: return FLAT_COMMA;
+            default: return FLAT_NO_VALUE;
+        }
+    }
+
+    // adds a syntax tree node of size bytes to the totals
+    void counted(size_t size) {
+        flatStats().treeNodes++;
+        flatStats().treeBytes += size;
+    }
+
+    FlatTree* tree;
+    NodeId made; // set by the visit of the node being flattened
+};
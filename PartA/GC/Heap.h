@@ -0,0 +1,191 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// anything the collector owns: runtime values (strings,
+// callables, instances) and Environments. every GcObject
+// must be made with new, since a collection deletes it
+class GcObject {
+public:
+    GcObject();
+    virtual ~GcObject();
+
+    // marks every GcObject this one refers to
+    virtual void trace() { }
+
+    // the sized delete gets the same size new was asked for
+    // (the destructor is virtual), so nothing is stored per block.
+    // new stays out of line: inlined, gcc sees ::operator new
+    // paired with this class's delete and warns they mismatch
+    __attribute__((noinline)) static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
+    bool marked;
+    bool linked; // still on the heap's list (a sweep takes it off first)
+    GcObject* next; // every live object is on one list
+};
+
+// a tracing mark-and-sweep collector. engines mark their roots
+// between startCollection() and finishCollection(), and only at
+// safe points, where every value still in use is reachable from
+// a root or from the temporaries pushed here
+class Heap {
+public:
+    Heap() {
+        objects = NULL;
+        bytesAllocated = 0;
+        threshold = 1024 * 1024;
+        nextGC = threshold;
+        growth = 2;
+
+        collections = 0;
+        bytesFreed = 0;
+        objectsFreed = 0;
+        totalPause = 0;
+        maxPause = 0;
+    }
+
+    bool shouldCollect() {
+        return bytesAllocated > nextGC;
+    }
+
+    void startCollection() {
+        pauseStart = chrono::steady_clock::now();
+
+        for (int i = 0; i < temps.size(); ++i) {
+            mark(temps[i]);
+        }
+    }
+
+    void finishCollection() {
+        // trace everything reachable from the roots
+        while (!gray.empty()) {
+            GcObject* o = gray.back();
+            gray.pop_back();
+            o->trace();
+        }
+        sweep();
+
+        size_t floor = (size_t) (bytesAllocated * growth);
+        nextGC = floor > threshold ? floor : threshold;
+
+        double pause = chrono::duration < double, milli >(chrono::steady_clock::now() - pauseStart).count();
+        collections++;
+        totalPause += pause;
+        if (pause > maxPause)
+            maxPause = pause;
+    }
+
+    void mark(GcObject* o) {
+        if (o == NULL || o->marked)
+            return;
+        o->marked = true;
+        gray.push_back(o);
+    }
+
+    // keeps o alive across safe points until it is popped.
+    // anything pushed while an error unwinds is dropped by
+    // whoever catches it, by resizing temps back to their mark
+    void push(GcObject* o) {
+        temps.push_back(o);
+    }
+
+    void pop(int count=1) {
+        temps.resize(temps.size() - count);
+    }
+
+    void report() {
+        cout << "[gc] collections: " << collections;
+        cout << ", paused " << totalPause << "ms (max " << maxPause << "ms)";
+        cout << ", freed " << bytesFreed << " bytes in " << objectsFreed << " objects";
+        cout << ", live " << bytesAllocated << " bytes" << endl;
+    }
+
+    GcObject* objects;
+    size_t bytesAllocated;
+    size_t threshold; // never collect before this many bytes are in use
+    size_t nextGC;
+    double growth; // next collection happens at live bytes * growth
+    vector < GcObject* > temps;
+
+    int collections;
+    size_t bytesFreed;
+    size_t objectsFreed;
+    double totalPause; // milliseconds
+    double maxPause;
+
+private:
+    void sweep() {
+        size_t before = bytesAllocated;
+        GcObject* previous = NULL;
+        GcObject* o = objects;
+        while (o != NULL) {
+            if (o->marked) {
+                o->marked = false;
+                previous = o;
+                o = o->next;
+            } else {
+                GcObject* unreached = o;
+                o = o->next;
+                if (previous != NULL)
+                    previous->next = o;
+                else
+                    objects = o;
+                unreached->linked = false;
+                delete unreached;
+                objectsFreed++;
+            }
+        }
+        bytesFreed += before - bytesAllocated;
+    }
+
+    // takes o off the list wherever it is. only an object whose
+    // constructor threw needs this, and it sits near the front
+    void unlink(GcObject* o) {
+        GcObject** at = &objects;
+        while (*at != NULL && *at != o)
+            at = &(*at)->next;
+        if (*at != NULL)
+            *at = o->next;
+    }
+
+    friend class GcObject;
+
+    vector < GcObject* > gray;
+    chrono::steady_clock::time_point pauseStart;
+};
+
+// the one heap every engine allocates from
+Heap& heap() {
+    static Heap h;
+    return h;
+}
+
+GcObject::GcObject() {
+    marked = false;
+    linked = true;
+    next = heap().objects;
+    heap().objects = this;
+}
+
+// a sweep unlinks what it deletes. if this object is still
+// linked, a derived constructor threw after this one ran, and
+// the list must not keep pointing at memory about to be freed
+GcObject::~GcObject() {
+    if (linked)
+        heap().unlink(this);
+}
+
+void* GcObject::operator new(size_t size) {
+    heap().bytesAllocated += size;
+    return ::operator new(size);
+}
+
+void GcObject::operator delete(void* p, size_t size) {
+    heap().bytesAllocated -= size;
+    ::operator delete(p);
+}
@@ -23,19 +23,6 @@ public:
 
 class ParseError : public exception { };
 
-class Break : public runtime_error {
-
-};
-
-class ReturnExcept : public exception {
-public:
-    ReturnExcept(Storable* v) {
-        value = v;
-    }
-
-    Storable* value;
-};
-
 class ErrHandler {
 public:
     bool SOURCE_HAD_ERROR; // triggered when an error is reported
@@ -50,7 +37,7 @@ public:
         if (t.type == EOF_)
             report(t.line, " at end", msg);
         else
-            report(t.line, " at '" + t.lexeme + "'", msg);
+            report(t.line, " at '" + t.lexeme() + "'", msg);
     }
 
     // reports a msg about where in line causes an error
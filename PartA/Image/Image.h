@@ -0,0 +1,730 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <string.h>
+#include <stdint.h>
+#include "../AST/Expr.h"
+#include "../AST/Stmt.h"
+#include "../AST/Arena.h"
+#include "../AST/CInterpreter.h"
+
+using namespace std;
+
+// a compiled script (.crxc): its resolved syntax tree, written out by
+// --compile so running it again skips lexing, parsing and resolving.
+// nothing in an image is a pointer. it is a header and four sections,
+// all found by their offset from the start of the file:
+//   text     every lexeme and string literal, once each
+//   names    the interned names, as (text offset, length) pairs
+//   numbers  every number literal, once each
+//   nodes    the tree in preorder, as 32 bit words
+// images are read in the byte order they were written in, and only
+// by the crx of the same IMAGE_VERSION
+
+// bumped whenever what is written for a node changes
+const uint32_t IMAGE_VERSION = 1;
+
+// set on the first word of a token that is a name
+const uint32_t IMAGE_NAMED = 0x80;
+
+// the depth written for a name the resolver left to the globals
+const uint32_t IMAGE_GLOBAL = 0xFFFFFFFF;
+
+// what a node in the nodes section is, ahead of its fields
+enum ImageTag {
+    IMG_NULL, // a child that isn't there (like a missing else)
+    IMG_ASSIGN, IMG_BINARY, IMG_UNARY, IMG_GROUPING, IMG_BOOLEAN,
+    IMG_NUMBER, IMG_STRING, IMG_NIL, IMG_VARIABLE, IMG_LOGICAL,
+    IMG_CALL, IMG_GET, IMG_SET, IMG_THIS, IMG_SUPER,
+    IMG_EXPRESSION, IMG_PRINT, IMG_VAR, IMG_BLOCK, IMG_IF, IMG_WHILE,
+    IMG_FUNCTION, IMG_RETURN, IMG_CLASS, IMG_BREAK, IMG_CONTINUE
+};
+
+class ImageHeader {
+public:
+    char magic[4]; // CRXC
+    uint32_t version;
+    uint64_t sourceHash; // of the script it was compiled from
+    uint32_t sourceLength;
+    uint32_t textOffset, textLength;
+    uint32_t namesOffset, nameCount;
+    uint32_t numbersOffset, numberCount;
+    uint32_t nodesOffset, nodeWords;
+    uint32_t stmtCount; // top level statements in the nodes section
+    uint64_t bodyHash; // of everything after the header
+};
+
+// FNV-1a, a word at a time, over length bytes at text. it tells a
+// script apart from the one an image was compiled from, and an image
+// apart from one damaged since it was written
+inline uint64_t hashBytes(const char* text, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, text + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < length; ++i) {
+        hash = (hash ^ (uint8_t) text[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// writes the image of a resolved (and folded) tree, with the depths
+// and slots the resolver left on the nodes that name variables
+class ImageWriter : public ExprVisitor<ImageWriter, void>, public StmtVisitor<ImageWriter, void> {
+public:
+    ImageWriter() {
+        names.push_back(0); // name 0 is no name, as Symbol 0 is
+    }
+
+    // the image of stmts, compiled from length bytes of source at text
+    string write(vector < Stmt* >& stmts, const char* text, size_t length) {
+        for (int i = 0; i < stmts.size(); ++i) {
+            stmt(stmts[i]);
+        }
+
+        ImageHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "CRXC", 4);
+        header.version = IMAGE_VERSION;
+        header.sourceHash = hashBytes(text, length);
+        header.sourceLength = length;
+        header.stmtCount = stmts.size();
+
+        // names go in the text too, so they are placed before it is written
+        vector < uint32_t > nameText;
+        for (int i = 1; i < names.size(); ++i) {
+            const string& name = symbols().name(names[i]);
+            nameText.push_back(textRef(name));
+            nameText.push_back(name.size());
+        }
+
+        string image((const char*) &header, sizeof(header));
+        header.textOffset = image.size();
+        header.textLength = this->text.size();
+        image += this->text;
+
+        align(image, 4);
+        header.namesOffset = image.size();
+        header.nameCount = names.size() - 1;
+        image.append((const char*) nameText.data(), nameText.size() * sizeof(uint32_t));
+
+        align(image, 8);
+        header.numbersOffset = image.size();
+        header.numberCount = numbers.size();
+        image.append((const char*) numbers.data(), numbers.size() * sizeof(double));
+
+        header.nodesOffset = image.size();
+        header.nodeWords = words.size();
+        image.append((const char*) words.data(), words.size() * sizeof(uint32_t));
+
+        header.bodyHash = hashBytes(image.data() + sizeof(header), image.size() - sizeof(header));
+        memcpy(&image[0], &header, sizeof(header));
+        return image;
+    }
+
+    void visitExpressionStmt(Expression* e) {
+        put(IMG_EXPRESSION);
+        expr(e->expr);
+    }
+
+    void visitPrintStmt(Print* p) {
+        put(IMG_PRINT);
+        expr(p->expr);
+    }
+
+    void visitVarStmt(Var* v) {
+        put(IMG_VAR);
+        token(v->name);
+        expr(v->initValue);
+    }
+
+    void visitBlockStmt(Block* b) {
+        put(IMG_BLOCK);
+        put(b->stmts.size());
+        for (int i = 0; i < b->stmts.size(); ++i) {
+            stmt(b->stmts[i]);
+        }
+    }
+
+    void visitIfStmt(If* i) {
+        put(IMG_IF);
+        expr(i->cond);
+        stmt(i->then);
+        stmt(i->else_);
+    }
+
+    void visitWhileStmt(While* w) {
+        put(IMG_WHILE);
+        expr(w->cond);
+        stmt(w->body);
+        expr(w->increment);
+    }
+
+    void visitFunctionStmt(Function* f) {
+        put(IMG_FUNCTION);
+        token(f->fnName);
+        put(f->params.size());
+        for (int i = 0; i < f->params.size(); ++i) {
+            token(f->params[i]);
+        }
+        stmt(f->body);
+    }
+
+    void visitReturnStmt(Return* r) {
+        put(IMG_RETURN);
+        token(r->ret);
+        expr(r->value);
+    }
+
+    void visitClassStmt(Class* c) {
+        put(IMG_CLASS);
+        token(c->name);
+        expr(c->superclass);
+        put(c->methods.size());
+        for (int i = 0; i < c->methods.size(); ++i) {
+            stmt(c->methods[i]);
+        }
+    }
+
+    void visitBreakStmt(Break* b) {
+        put(IMG_BREAK);
+        token(b->keyword);
+    }
+
+    void visitContinueStmt(Continue* c) {
+        put(IMG_CONTINUE);
+        token(c->keyword);
+    }
+
+    void visitAssignExpr(Assign* a) {
+        put(IMG_ASSIGN);
+        token(a->name);
+        expr(a->value);
+        local(a->local);
+    }
+
+    void visitBinaryExpr(Binary* b) {
+        put(IMG_BINARY);
+        expr(b->left);
+        token(b->op);
+        expr(b->right);
+    }
+
+    void visitUnaryExpr(Unary* u) {
+        put(IMG_UNARY);
+        token(u->op);
+        expr(u->right);
+    }
+
+    void visitGroupingExpr(Grouping* g) {
+        put(IMG_GROUPING);
+        expr(g->expr);
+    }
+
+    void visitBooleanExpr(Boolean* b) {
+        put(IMG_BOOLEAN);
+        put(b->value);
+    }
+
+    void visitNumberExpr(Number* n) {
+        put(IMG_NUMBER);
+        put(numberRef(n->value));
+    }
+
+    void visitStringExpr(String* s) {
+        put(IMG_STRING);
+        put(textRef(s->value));
+        put(s->value.size());
+    }
+
+    void visitNilExpr(Nil* n) {
+        put(IMG_NIL);
+    }
+
+    void visitVariableExpr(Variable* v) {
+        put(IMG_VARIABLE);
+        token(v->name);
+        local(v->local);
+    }
+
+    void visitLogicalExpr(Logical* l) {
+        put(IMG_LOGICAL);
+        expr(l->left);
+        token(l->op);
+        expr(l->right);
+    }
+
+    void visitCallExpr(Call* c) {
+        put(IMG_CALL);
+        expr(c->callee);
+        token(c->rParen);
+        put(c->arguments.size());
+        for (int i = 0; i < c->arguments.size(); ++i) {
+            expr(c->arguments[i]);
+        }
+    }
+
+    void visitGetExpr(Get* g) {
+        put(IMG_GET);
+        expr(g->object);
+        token(g->name);
+    }
+
+    void visitSetExpr(Set* s) {
+        put(IMG_SET);
+        expr(s->object);
+        token(s->name);
+        expr(s->value);
+    }
+
+    void visitThisExpr(This* t) {
+        put(IMG_THIS);
+        token(t->keyword);
+        local(t->local);
+    }
+
+    void visitSuperExpr(Super* s) {
+        put(IMG_SUPER);
+        token(s->keyword);
+        token(s->property);
+        local(s->local);
+    }
+
+private:
+    void put(uint32_t w) {
+        words.push_back(w);
+    }
+
+    void expr(Expr* e) {
+        if (e == NULL)
+            put(IMG_NULL);
+        else
+            visitExpr(e);
+    }
+
+    void stmt(Stmt* s) {
+        if (s == NULL)
+            put(IMG_NULL);
+        else
+            visitStmt(s);
+    }
+
+    // a token is three words: its type and lexeme length (with
+    // IMAGE_NAMED set for a name), its line, and then either its name
+    // or where its lexeme is in the text. columns aren't kept, as
+    // nothing past the lexer uses them. no token kept on a node is
+    // near 16MB long (string literals keep their value, not a token)
+    void token(const Token& t) {
+        if (t.symbol != 0 && t.length == symbols().name(t.symbol).size()) {
+            put(t.type | IMAGE_NAMED | t.length << 8);
+            put(t.line);
+            put(nameRef(t.symbol));
+        } else {
+            string lexeme = t.lexeme();
+            put(t.type | lexeme.size() << 8);
+            put(t.line);
+            put(textRef(lexeme));
+        }
+    }
+
+    // the depth and slot the resolver gave e,
+    // or IMAGE_GLOBAL when it left e to the globals
+    void local(const LocalSlot& l) {
+        if (l.isGlobal()) {
+            put(IMAGE_GLOBAL);
+            put(0);
+        } else {
+            put(l.depth);
+            put(l.slot);
+        }
+    }
+
+    // where s starts in the text section, adding it the first time
+    uint32_t textRef(const string& s) {
+        unordered_map < string, uint32_t >::iterator found = textAt.find(s);
+        if (found != textAt.end())
+            return found->second;
+        uint32_t at = text.size();
+        text += s;
+        textAt.insert(make_pair(s, at));
+        return at;
+    }
+
+    uint32_t nameRef(Symbol s) {
+        if (s == 0)
+            return 0;
+        unordered_map < Symbol, uint32_t >::iterator found = nameAt.find(s);
+        if (found != nameAt.end())
+            return found->second;
+        uint32_t at = names.size();
+        names.push_back(s);
+        nameAt.insert(make_pair(s, at));
+        return at;
+    }
+
+    // numbers are told apart by their bits, so -0 keeps its sign
+    uint32_t numberRef(double n) {
+        uint64_t bits;
+        memcpy(&bits, &n, sizeof(bits));
+        unordered_map < uint64_t, uint32_t >::iterator found = numberAt.find(bits);
+        if (found != numberAt.end())
+            return found->second;
+        uint32_t at = numbers.size();
+        numbers.push_back(n);
+        numberAt.insert(make_pair(bits, at));
+        return at;
+    }
+
+    static void align(string& image, size_t to) {
+        while (image.size() % to != 0) {
+            image += '\0';
+        }
+    }
+
+    vector < uint32_t > words;
+    string text;
+    unordered_map < string, uint32_t > textAt;
+    vector < Symbol > names; // by name index
+    unordered_map < Symbol, uint32_t > nameAt;
+    vector < double > numbers;
+    unordered_map < uint64_t, uint32_t > numberAt;
+};
+
+// rebuilds the tree of an image into an arena, without lexing, parsing
+// or resolving anything. the image's text is added to sourceBuffer()
+// where it lies, so the image has to stay put for the rest of the run
+// (like a mapped script). an image that no longer matches the hash it
+// was written with is turned down, and what is read from one that does
+// is still kept within its bounds
+class ImageReader {
+public:
+    ImageReader(Arena* arena) {
+        this->arena = arena;
+        header = NULL;
+        problem = "";
+    }
+
+    // checks the header of the size bytes at image, setting problem
+    // when they aren't an image this crx can run
+    bool open(const char* image, size_t size) {
+        this->image = image;
+        header = (const ImageHeader*) image;
+        if (size < sizeof(ImageHeader) || memcmp(header->magic, "CRXC", 4) != 0) {
+            problem = "is not a compiled script";
+            return false;
+        }
+        if (header->version != IMAGE_VERSION) {
+            problem = "was compiled by another version of crx";
+            return false;
+        }
+        if (!fits(header->textOffset, header->textLength, 1, size) ||
+            !fits(header->namesOffset, header->nameCount, 2 * sizeof(uint32_t), size) ||
+            !fits(header->numbersOffset, header->numberCount, sizeof(double), size) ||
+            !fits(header->nodesOffset, header->nodeWords, sizeof(uint32_t), size) ||
+            header->namesOffset % 4 != 0 || header->numbersOffset % 8 != 0 ||
+            header->nodesOffset % 4 != 0 ||
+            hashBytes(image + sizeof(ImageHeader), size - sizeof(ImageHeader)) != header->bodyHash) {
+            problem = "is damaged";
+            return false;
+        }
+        return true;
+    }
+
+    // the top level statements of the image open checked, with
+    // every resolved name's depth and slot back on its node
+    bool read(vector < Stmt* >& stmts) {
+        base = sourceBuffer().add(image + header->textOffset, header->textLength);
+        const uint32_t* names = (const uint32_t*) (image + header->namesOffset);
+        symbolOf.push_back(0);
+        nameText.push_back(0);
+        for (uint32_t i = 0; i < header->nameCount; ++i) {
+            uint32_t at = names[2 * i], length = names[2 * i + 1];
+            if (!inText(at, length)) {
+                problem = "is damaged";
+                return false;
+            }
+            const char* name = image + header->textOffset + at;
+            symbolOf.push_back(symbols().intern(name, length, hashName(name, length)));
+            nameText.push_back(at);
+        }
+        numbers = (const double*) (image + header->numbersOffset);
+        words = (const uint32_t*) (image + header->nodesOffset);
+        next = 0;
+        damaged = false;
+
+        for (uint32_t i = 0; i < header->stmtCount && !damaged; ++i) {
+            stmts.push_back(stmt());
+        }
+        if (damaged || next != header->nodeWords) {
+            problem = "is damaged";
+            stmts.clear();
+            return false;
+        }
+        return true;
+    }
+
+    const ImageHeader* header; // set by open
+    string problem; // why open or read turned the image down
+
+private:
+    // whether count items of size bytes at offset are all in the image
+    static bool fits(uint32_t offset, uint32_t count, size_t size, size_t imageSize) {
+        return offset <= imageSize && (uint64_t) count * size <= imageSize - offset;
+    }
+
+    bool inText(uint32_t at, uint32_t length) {
+        return at <= header->textLength && length <= header->textLength - at;
+    }
+
+    uint32_t word() {
+        if (next >= header->nodeWords) {
+            damaged = true;
+            return 0;
+        }
+        return words[next++];
+    }
+
+    Token token() {
+        uint32_t kind = word();
+        int line = word();
+        uint32_t ref = word();
+        uint32_t type = kind & 0x7F;
+        uint32_t length = kind >> 8;
+        if (type > EOF_) {
+            damaged = true;
+            return Token();
+        }
+
+        if (kind & IMAGE_NAMED) {
+            // a name's lexeme is the name, in the text already
+            if (ref == 0 || ref >= symbolOf.size() || !inText(nameText[ref], length)) {
+                damaged = true;
+                return Token();
+            }
+            Token t((TokenType) type, base + nameText[ref], length, line);
+            t.symbol = symbolOf[ref];
+            return t;
+        }
+        if (!inText(ref, length)) {
+            damaged = true;
+            return Token();
+        }
+        return Token((TokenType) type, base + ref, length, line);
+    }
+
+    // reads back the depth and slot written for a name into l
+    void local(LocalSlot& l) {
+        uint32_t depth = word();
+        uint32_t slot = word();
+        if (depth != IMAGE_GLOBAL)
+            l = LocalSlot(depth, slot);
+    }
+
+    // a child that has to be there
+    Expr* expr() {
+        Expr* e = optionalExpr();
+        if (e == NULL)
+            damaged = true;
+        return e;
+    }
+
+    Expr* optionalExpr() {
+        switch (word()) {
+            case IMG_NULL: return NULL;
+            case IMG_ASSIGN: {
+                Token name = token();
+                Expr* value = expr();
+                Assign* a = new (*arena) Assign(name, value);
+                local(a->local);
+                return a;
+            }
+            case IMG_BINARY: {
+                Expr* left = expr();
+                Token op = token();
+                Expr* right = expr();
+                // the options of a ternary are read as one Binary
+                if (op.type == QUESTION_MARK && (right == NULL || right->kind != NODE_BINARY))
+                    damaged = true;
+                return new (*arena) Binary(left, op, right);
+            }
+            case IMG_UNARY: {
+                Token op = token();
+                Expr* right = expr();
+                return new (*arena) Unary(op, right);
+            }
+            case IMG_GROUPING: return new (*arena) Grouping(expr());
+            case IMG_BOOLEAN: return new (*arena) Boolean(word() != 0);
+            case IMG_NUMBER: {
+                uint32_t n = word();
+                if (n >= header->numberCount) {
+                    damaged = true;
+                    return NULL;
+                }
+                return new (*arena) Number(numbers[n]);
+            }
+            case IMG_STRING: {
+                uint32_t at = word();
+                uint32_t length = word();
+                if (!inText(at, length)) {
+                    damaged = true;
+                    return NULL;
+                }
+                return new (*arena) String(string(image + header->textOffset + at, length));
+            }
+            case IMG_NIL: return new (*arena) Nil();
+            case IMG_VARIABLE: {
+                Variable* v = new (*arena) Variable(token());
+                local(v->local);
+                return v;
+            }
+            case IMG_LOGICAL: {
+                Expr* left = expr();
+                Token op = token();
+                Expr* right = expr();
+                return new (*arena) Logical(left, op, right);
+            }
+            case IMG_CALL: {
+                Expr* callee = expr();
+                Token paren = token();
+                vector < Expr* > arguments;
+                for (uint32_t n = count(); n > 0 && !damaged; --n) {
+                    arguments.push_back(expr());
+                }
+                return new (*arena) Call(callee, paren, arguments);
+            }
+            case IMG_GET: {
+                Expr* object = expr();
+                Token name = token();
+                return new (*arena) Get(object, name);
+            }
+            case IMG_SET: {
+                Expr* object = expr();
+                Token name = token();
+                Expr* value = expr();
+                return new (*arena) Set(object, name, value);
+            }
+            case IMG_THIS: {
+                This* t = new (*arena) This(token());
+                local(t->local);
+                return t;
+            }
+            case IMG_SUPER: {
+                Token keyword = token();
+                Token property = token();
+                Super* s = new (*arena) Super(keyword, property);
+                local(s->local);
+                return s;
+            }
+            default:
+                damaged = true;
+                return NULL;
+        }
+    }
+
+    Stmt* stmt() {
+        Stmt* s = optionalStmt();
+        if (s == NULL)
+            damaged = true;
+        return s;
+    }
+
+    Stmt* optionalStmt() {
+        switch (word()) {
+            case IMG_NULL: return NULL;
+            case IMG_EXPRESSION: return new (*arena) Expression(expr());
+            case IMG_PRINT: return new (*arena) Print(optionalExpr());
+            case IMG_VAR: {
+                Token name = token();
+                Expr* value = optionalExpr();
+                return new (*arena) Var(name, value);
+            }
+            case IMG_BLOCK: return block();
+            case IMG_IF: {
+                Expr* cond = expr();
+                Stmt* then = stmt();
+                Stmt* else_ = optionalStmt();
+                return new (*arena) If(cond, then, else_);
+            }
+            case IMG_WHILE: {
+                Expr* cond = expr();
+                Stmt* body = stmt();
+                Expr* increment = optionalExpr();
+                return new (*arena) While(cond, body, increment);
+            }
+            case IMG_FUNCTION: return function();
+            case IMG_RETURN: {
+                Token ret = token();
+                Expr* value = optionalExpr();
+                return new (*arena) Return(ret, value);
+            }
+            case IMG_CLASS: {
+                Token name = token();
+                Expr* superclass = optionalExpr();
+                if (superclass != NULL && superclass->kind != NODE_VARIABLE)
+                    damaged = true;
+                vector < Function* > methods;
+                for (uint32_t n = count(); n > 0 && !damaged; --n) {
+                    if (word() != IMG_FUNCTION) {
+                        damaged = true;
+                        break;
+                    }
+                    methods.push_back(function());
+                }
+                return new (*arena) Class(name, (Variable*) superclass, methods);
+            }
+            case IMG_BREAK: return new (*arena) Break(token());
+            case IMG_CONTINUE: return new (*arena) Continue(token());
+            default:
+                damaged = true;
+                return NULL;
+        }
+    }
+
+    // a block, with its tag already read
+    Block* block() {
+        vector < Stmt* > stmts;
+        for (uint32_t n = count(); n > 0 && !damaged; --n) {
+            stmts.push_back(stmt());
+        }
+        return new (*arena) Block(stmts);
+    }
+
+    // a function, with its tag already read
+    Function* function() {
+        Token name = token();
+        vector < Token > params;
+        for (uint32_t n = count(); n > 0 && !damaged; --n) {
+            params.push_back(token());
+        }
+        Block* body = NULL;
+        if (word() == IMG_BLOCK)
+            body = block();
+        else
+            damaged = true;
+        return new (*arena) Function(name, params, body);
+    }
+
+    // the length of a list, which can't be longer than the words left
+    uint32_t count() {
+        uint32_t n = word();
+        if (n > header->nodeWords - next)
+            damaged = true;
+        return damaged ? 0 : n;
+    }
+
+    Arena* arena;
+    const char* image;
+    uint32_t base; // where the text section starts in sourceBuffer()
+    vector < Symbol > symbolOf; // by name index
+    vector < uint32_t > nameText; // where each name is in the text
+    const double* numbers;
+    const uint32_t* words;
+    uint32_t next; // the next word to read
+    bool damaged;
+};
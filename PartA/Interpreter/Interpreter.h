@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <vector>
+#include <typeinfo>
 #include "../AST/Expr.h"
 #include "../AST/Stmt.h"
 #include "../AST/TokenTypes.h"
@@ -14,97 +15,90 @@
 
 using namespace std;
 
-bool isTruthy(Expr *e) {
-    switch(e->type()) {
-        case 'N': { // number
-            double n = dynamic_cast<Number *>(e)->value;
-            if (n <= 0)
-                return false;
-            return true;
+bool isTruthy(Value v) {
+    if (v.isBool())
+        return v.asBool();
+
+    if (v.isNumber())
+        return v.asNumber() > 0;
+
+    // NIL (and the missing value of a void call)
+    if (v.isNil() || v.isNone())
+        return false;
+
+    CroixString* s = v.asString();
+    if (s != NULL)
+        return s->value != "";
+    return true;
+}
+
+// the type letter an Expr literal used to report for
+// the same value: N(umber), s(tring), B(oolean), \0 for nil
+// and O for any other object
+char valueType(Value v) {
+    if (v.isNumber()) return 'N';
+    if (v.isBool()) return 'B';
+    if (v.isNil() || v.isNone()) return '\0';
+    if (v.asString() != NULL) return 's';
+    return 'O';
+}
+
+bool areEqual(Value a, Value b) {
+    char at = valueType(a);
+    char bt = valueType(b);
+    if ((at == bt) == '\0') // values of different types
+        return true;
+
+    switch(at) {
+        case 'N': {
+            return a.asNumber() == b.asNumber();
             break;
         }
-        // string
         case 's': {
-            string s = dynamic_cast<String *>(e)->value;
-            if (s == "")
-                return false;
-            return true;
+            return a.asString()->value == b.asString()->value;
             break;
         }
-        // NIL
-        case '\0': {
-            return false;
+        case 'B': {
+            return a.asBool() == b.asBool();
             break;
         }
-        // actual boolean
-        case 'B': {
-            return dynamic_cast<Boolean *>(e)->value;
+        case 'O': {
+            return a.asObject() == b.asObject();
             break;
         }
         default:
-            return true;
+            return false;
     }
 }
 
-bool areEqual(Expr *a, Expr *b) {
-    if (a->type() == b->type() == '\0') // both Nil
-        return true;
-    
-    if (a->type() == b->type()) {
-        switch(a->type()) {
-            case 'N': {
-                double rn = dynamic_cast<Number *>(a)->value;
-                double ln = dynamic_cast<Number *>(b)->value;
-                return rn == ln;
-                break;
-            }
-            case 's': {
-                string s1 = dynamic_cast<String *>(a)->value;
-                string s2 = dynamic_cast<String *>(b)->value;
-                return s1 == s2;
-                break;
-            }
-            case 'B': {
-                bool b1 = dynamic_cast<Boolean *>(a)->value;
-                bool b2 = dynamic_cast<Boolean *>(b)->value;
-                return b1 == b2;
-                break;
-            }
-            default:
-                return false;
-        }
-    } else 
-        return false;
-}
-
-bool isN(Expr *a) {
-    return a->type() == 'N';
+bool isN(Value a) {
+    return a.isNumber();
 }
 
-bool isStr(Expr *a) {
-    return a->type() == 's';
+bool isStr(Value a) {
+    return a.asString() != NULL;
 }
 
-bool isBool(Expr *a) {
-    return a->type() == 'B';
+bool isBool(Value a) {
+    return a.isBool();
 }
 
-bool isNumber(Token op, Expr *e) {
+bool isNumber(Token op, Value e) {
     if (isN(e)) return true;
     throw RuntimeError(op, "Operand must be a Number.");
 }
 
-bool areNumbers(Token op, Expr *a, Expr *b) {
+bool areNumbers(Token op, Value a, Value b) {
     if (isN(a) && isN(b)) return true;
     throw RuntimeError(op, "Operands must be 2 Numbers.");
 }
 
-bool areStrings(Token op, Expr *a, Expr *b) {
+bool areStrings(Token op, Value a, Value b) {
     if (isStr(a) && isStr(b)) return true;
     throw RuntimeError(op, "Operands must be 2 Strings.");
 }
 
-bool areNumbersOrStrings(Token op, Expr *a, Expr *b) {
+bool areNumbersOrStrings(Token op, Value a, Value b) {
     if (isStr(a) && isStr(b))
         return true;
         
@@ -113,7 +107,110 @@ bool areNumbersOrStrings(Token op, Expr *a, Expr *b) {
     throw RuntimeError(op, "Operands must be 2 Numbers or 2 Strings.");
 }
 
-class Interpreter : public CInterpreter {
+bool hasArity(Token paren, int arity, int argCount) {
+    if (arity == argCount) return true;
+    string eMsg = "Expected ";
+    eMsg += to_string(arity) + " arguments but got ";
+    eMsg += to_string(argCount) + ".";
+    throw RuntimeError(paren, eMsg);
+}
+
+// what a print statement writes for a value, shared by
+// both execution engines so their output stays identical
+void printStored(CInterpreter* in, Value v) {
+    if (v.isNone())
+        return;
+
+    if (!v.isObject() || isStr(v)) {
+        in->showValue(v);
+        return;
+    }
+
+    Callable* fn = dynamic_cast<Callable *>(v.asObject());
+    if (fn != NULL)
+        cout << fn->toString() << endl;
+    else
+        cout << v.asObject()->storedType() << endl;
+}
+
+// the rest of a call, once callee and then each of args were
+// evaluated and protected: they are all popped when it returns
+Value finishCall(CInterpreter* in, Token paren, CallCache& cache, Value callee, vector < Value >& args) {
+    Callable* fn = cachedCallee(cache, callee);
+
+    if (fn == NULL) // not a callable, since it couldn't cast
+        throw RuntimeError(paren, "Can only call functions and classes.");
+
+    hasArity(paren, cache.arity, args.size());
+
+    Value res = fn->call(in, args);
+    heap().pop(args.size() + 1);
+    return res;
+}
+
+// the rest of calling method with receiver as "this", once receiver
+// and then each of args were evaluated and protected
+Value finishInvoke(CInterpreter* in, Token paren, UserFunction* method, Value receiver, vector < Value >& args) {
+    hasArity(paren, method->arity(), args.size());
+
+    Value res = method->invoke(in, receiver, args);
+    heap().pop(args.size() + 1);
+    return res;
+}
+
+// declares class c in the current scope of in, the same way under
+// every engine. super is what c's superclass evaluated to (when it
+// has one), and chunks the compiled bodies of c's methods, in order,
+// when the VM is the one running it
+void declareClass(CInterpreter* in, Class* c, Value super, vector < Chunk* >* chunks=NULL) {
+    CroixClass* superclass = NULL;
+    if (c->superclass != NULL) {
+        // check to see if super is resolved into a CroixClass
+        if (super.isObject())
+            superclass = dynamic_cast<CroixClass*>(super.asObject());
+
+        if (superclass == NULL) {
+            throw RuntimeError(c->superclass->name, "Superclass must be a class");
+        }
+    }
+
+    // allows class to refer to itself
+    int classSlot = in->env->slots.size();
+    in->define(c->name.symbol, Value::nil());
+
+    if (superclass != NULL) {
+        in->env = new Environment(in->env->handler, in->env, true);
+        in->env->defineSlot(Value::object(superclass));
+    }
+
+    Environment* methods = new Environment(NULL, NULL, true);
+    for (int i = 0; c->methods.size() > i; ++i) {
+        Function* fn = c->methods[i];
+        bool isInit = fn->fnName.symbol == intern("init");
+
+        // in the case where we have a superclass, all methods in our class
+        // capture the env that has a reference to "super"
+        // and then we later pop it off
+        UserFunction* method = new UserFunction(fn, in->env, isInit);
+        if (chunks != NULL)
+            method->chunk = (*chunks)[i];
+        methods->define(fn->fnName.symbol, Value::object(method));
+    }
+
+    CroixClass* uc = new CroixClass(c->name.lexeme(), superclass, methods);
+
+    // after letting methods bind to env with reference to super,
+    // we pop off that env and return to its parent.
+    if (superclass != NULL) {
+        in->env = in->env->parent;
+    }
+    if (in->env == in->globals)
+        in->env->assign(c->name, Value::object(uc));
+    else
+        in->env->slots[classSlot] = Value::object(uc);
+}
+
+class Interpreter : public CInterpreter, public ExprVisitor<Interpreter, Value>, public StmtVisitor<Interpreter, Completion> {
 public:
     Interpreter(ErrHandler* e, bool interactiveMode=false, Environment* globals=NULL) { 
         handler = e;
@@ -124,141 +221,144 @@ public:
         else
             env = new Environment(e);
 
-        globals->define("clock", (Storable*) new Clock());
+        globals->define(intern("clock"), Value::object(new Clock()));
         // used to help resolver integration
         this->globals = globals;
     }
 
-    void resolve(Expr* expr, int scopeDepth) {
-        locals.insert(pair < Expr*, int >(expr, scopeDepth));
+    Value eval(Expr* in) {
+        return visitExpr(in);
     }
 
-    Storable* eval(Expr* in) {
-        return in->accept(this);
-    }
+    // the larger visits are kept out of visitExpr's switch: inlined
+    // there, every eval (even of a number) pays for their stack frame
+    __attribute__((noinline)) Value visitBinaryExpr(Binary* e) {
+        // only the right hand side's value is kept, so
+        // each side must be evaluated exactly once
+        if (e->op.type == COMMA) {
+            eval(e->left);
+            return eval(e->right);
+        }
 
-    Storable* visitBinaryExpr(Binary* e) {
-        Expr *l = dynamic_cast<Expr *>(eval(e->left));
-        Expr *r;
-        if (e->op.type != QUESTION_MARK)
-            r = dynamic_cast<Expr *>(eval(e->right));
+        Value l = eval(e->left);
+        Value r;
+        if (e->op.type != QUESTION_MARK) {
+            protect(l);
+            r = eval(e->right);
+            heap().pop();
+        }
 
         switch(e->op.type) {
             case GREATER: {
                 if (areNumbers(e->op, l, r)) {
-                    double rn = dynamic_cast<Number *>(r)->value;
-                    double ln = dynamic_cast<Number *>(l)->value;
+                    double rn = r.asNumber();
+                    double ln = l.asNumber();
                     
-                    return new Boolean(ln > rn);
+                    return Value::boolean(ln > rn);
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;
             }
             case GREATER_EQUAL: {
                 if (areNumbers(e->op, l, r)) {
-                    double rn = dynamic_cast<Number *>(r)->value;
-                    double ln = dynamic_cast<Number *>(l)->value;
+                    double rn = r.asNumber();
+                    double ln = l.asNumber();
                     
-                    return new Boolean(ln >= rn);
+                    return Value::boolean(ln >= rn);
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;
             }
             case LESS: {
                 if (areNumbers(e->op, l, r)) {
-                    double rn = dynamic_cast<Number *>(r)->value;
-                    double ln = dynamic_cast<Number *>(l)->value;
+                    double rn = r.asNumber();
+                    double ln = l.asNumber();
                     
-                    return new Boolean(ln < rn);
+                    return Value::boolean(ln < rn);
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;
             }
             case LESS_EQUAL: {
                 if (areNumbers(e->op, l, r)) {
-                    double rn = dynamic_cast<Number *>(r)->value;
-                    double ln = dynamic_cast<Number *>(l)->value;
+                    double rn = r.asNumber();
+                    double ln = l.asNumber();
                     
-                    return new Boolean(ln <= rn);
+                    return Value::boolean(ln <= rn);
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;
             }
             case NOT_EQUAL: {
-                return new Boolean(!areEqual(l, r));
+                return Value::boolean(!areEqual(l, r));
                 break;
             }
             case EQUAL_EQUAL: {
-                return new Boolean(areEqual(l, r));
+                return Value::boolean(areEqual(l, r));
                 break;
             }
             case PLUS: {
                 if (areNumbersOrStrings(e->op, l, r)) {
                     if (isN(l)) {
-                        double rn = dynamic_cast<Number *>(r)->value;
-                        double ln = dynamic_cast<Number *>(l)->value;
+                        double rn = r.asNumber();
+                        double ln = l.asNumber();
 
-                        return new Number(ln+rn);
+                        return Value::number(ln+rn);
                     } else {
-                        string rn = dynamic_cast<String *>(r)->value;
-                        string ln = dynamic_cast<String *>(l)->value;
+                        string rn = r.asString()->value;
+                        string ln = l.asString()->value;
                     
-                        return new String(ln+rn);
+                        return Value::object(new CroixString(ln+rn));
                     }
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;
             }
             case MINUS: {
                 if (areNumbers(e->op, l, r)) {
-                    double rn = dynamic_cast<Number *>(r)->value;
-                    double ln = dynamic_cast<Number *>(l)->value;
+                    double rn = r.asNumber();
+                    double ln = l.asNumber();
 
-                    return new Number(ln-rn);
+                    return Value::number(ln-rn);
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;            }
             case MULT: {
                 if (areNumbers(e->op, l, r)) {
-                    double rn = dynamic_cast<Number *>(r)->value;
-                    double ln = dynamic_cast<Number *>(l)->value;
+                    double rn = r.asNumber();
+                    double ln = l.asNumber();
 
-                    return new Number(rn*ln);
+                    return Value::number(rn*ln);
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;
             }
             case SLASH: {
                 if (areNumbers(e->op, l, r)) {
-                    double rn = dynamic_cast<Number *>(r)->value;
-                    double ln = dynamic_cast<Number *>(l)->value;
+                    double rn = r.asNumber();
+                    double ln = l.asNumber();
 
                     if (rn != 0) 
-                        return new Number(ln / rn);
+                        return Value::number(ln / rn);
                     else
                         throw RuntimeError(e->op, "Division by Zero.");
                 } else {
-                    return NULL;
+                    return Value();
                 }
                 break;
             }
-            case COMMA: {
-                eval(e->left);
-                return eval(e->right);
-                break;
-            }
             case QUESTION_MARK: {
                 bool chooseL = isTruthy(l);
 
                 // the right side of this Binary contains our options
-                Binary *b = dynamic_cast<Binary *>(e->right);
+                Binary *b = static_cast<Binary *>(e->right);
                 if (chooseL) {
                     return eval(b->left);
                 } else {
@@ -267,78 +367,76 @@ public:
                 break;
             }
             default: {
-                return NULL;
+                return Value();
             }
         }
     }  
 
-    Storable* visitUnaryExpr(Unary* e) {
-        Expr *r = dynamic_cast<Expr *>(eval(e->right));
+    __attribute__((noinline)) Value visitUnaryExpr(Unary* e) {
+        Value r = eval(e->right);
 
         switch(e->op.type) {
             case NOT: {
-                return new Boolean(!isTruthy(r));
+                return Value::boolean(!isTruthy(r));
                 break;
             }
             case MINUS: {
                 // we do have a number
                 if (isNumber(e->op, r)) {
-                    double n = dynamic_cast<Number *>(r)->value;
-                    return new Number(-n);
+                    double n = r.asNumber();
+                    return Value::number(-n);
                 }
-                return NULL;
+                return Value();
                 break;
             }
             default: {
-                return NULL;
+                return Value();
             }
         }
     }
 
-    Storable* visitGroupingExpr(Grouping* e) {
+    Value visitGroupingExpr(Grouping* e) {
         return eval(e->expr);
     }
 
-    Storable* visitBooleanExpr(Boolean* e) {
-        return e;
+    Value visitBooleanExpr(Boolean* e) {
+        return Value::boolean(e->value);
     }
 
-    Storable* visitNumberExpr(Number* e) {
-        return e;
+    Value visitNumberExpr(Number* e) {
+        return Value::number(e->value);
     }
 
-    Storable* visitStringExpr(String* e) {
-        return e;
+    Value visitStringExpr(String* e) {
+        return Value::object(new CroixString(e->value));
     }
 
-    Storable* visitNilExpr(Nil* e) {
-        return e;
+    Value visitNilExpr(Nil* e) {
+        return Value::nil();
     }
 
-    Storable* visitVariableExpr(Variable* e) {
-        // Storable *v = env->get(e->name);
+    Value visitVariableExpr(Variable* e) {
+        // Value v = env->get(e->name);
         // return v;    
-        return lookupVariable(e->name, e);
+        return lookupVariable(e->name, e->local);
     }
 
-    Storable* lookupVariable(Token name, Expr* e) {
-        map < Expr*, int >::iterator iDepth = locals.find(e);
+    Value lookupVariable(Token name, const LocalSlot& local) {
         // not recognized as a local variable, check globally
-        if (iDepth == locals.end()) {
+        if (local.isGlobal()) {
             return globals->get(name);
         } else {
-            return env->getAtDepth(iDepth->second, name);
+            return env->getAt(local.depth, local.slot);
         }
     }
 
-    Storable* visitAssignExpr(Assign* e) {
-        Storable *v = eval(e->value);
+    __attribute__((noinline)) Value visitAssignExpr(Assign* e) {
+        Value v = eval(e->value);
         
-        map < Expr*, int >::iterator iDepth = locals.find(e);
-        if (iDepth == locals.end()) {
+        if (e->local.isGlobal()) {
             globals->assign(e->name, v);
         } else {
-            env->assignAtDepth(iDepth->second, e->name, v);
+            env->assignAt(e->local.depth, e->local.slot, v);
         }
 
         return v;
@@ -346,8 +444,8 @@ public:
         // return v;
     }
 
-    Storable* visitLogicalExpr(Logical* e) {
-        Expr* lhs = dynamic_cast<Expr *>(eval(e->left));
+    __attribute__((noinline)) Value visitLogicalExpr(Logical* e) {
+        Value lhs = eval(e->left);
 
         // perform short circuiting appropriately
         // for OR, if the LHS is true, then return it
@@ -360,78 +458,88 @@ public:
         return eval(e->right);
     }
 
-    Storable* visitCallExpr(Call* e) {    
-        Storable* callee = eval(e->callee);
-        vector < Storable* > args;
+    __attribute__((noinline)) Value visitCallExpr(Call* e) {    
+        Value callee;
+        if (e->callee->kind == NODE_GET) {
+            // obj.name(args) calls a method straight on obj
+            Get* g = static_cast<Get*>(e->callee);
+            Value receiver = eval(g->object);
+            CroixClass::CroixClassInstance* inst = asInstance(receiver);
+
+            if (inst == NULL)
+                throw RuntimeError(g->name, "Only class instances have properties.");
+
+            UserFunction* method;
+            callee = inst->lookup(g->name, g->cache, method);
+            if (method != NULL)
+                return invoke(e, method, receiver);
+            callee = inst->rebind(callee);
+        } else {
+            callee = eval(e->callee);
+        }
+
+        vector < Value > args;
+        protect(callee);
 
         for (int i = 0; i < e->arguments.size(); ++i) {
             args.push_back(eval(e->arguments[i]));
+            protect(args.back());
         }
+        return finishCall(this, e->rParen, e->cache, callee, args);
+    }
 
-        Callable* fn = dynamic_cast< Callable *>(callee);
-
-        if (fn == NULL) // not a callable, since it couldn't cast
-            throw RuntimeError(e->rParen, "Can only call functions and classes.");
+    // calls method with receiver as "this", without
+    // making a BoundMethod for the pair
+    Value invoke(Call* e, UserFunction* method, Value receiver) {
+        vector < Value > args;
+        protect(receiver);
 
-        if (fn->arity() != args.size()) { // wrong function arity
-            string eMsg = "Expected ";
-            eMsg += to_string(fn->arity()) + " arguments but got ";
-            eMsg += to_string(args.size()) + ".";
-            throw RuntimeError(e->rParen, eMsg);
+        for (int i = 0; i < e->arguments.size(); ++i) {
+            args.push_back(eval(e->arguments[i]));
+            protect(args.back());
         }
-
-        Storable* res = fn->call(this, args);
-        return res;    
+        return finishInvoke(this, e->rParen, method, receiver, args);
     }
 
-    Storable* visitGetExpr(Get* g) {
-        Storable* lhs = eval(g->object);
-
-        CroixClass::CroixClassInstance* inst = dynamic_cast<CroixClass::CroixClassInstance*>(lhs);
+    __attribute__((noinline)) Value visitGetExpr(Get* g) {
+        CroixClass::CroixClassInstance* inst = asInstance(eval(g->object));
 
         if (inst != NULL) {
-            return inst->get(g->name);
+            return inst->get(g->name, g->cache);
         }
 
         throw RuntimeError(g->name, "Only class instances have properties.");
     }
 
-    Storable* visitSetExpr(Set* s) {
-        Storable* lhs = eval(s->object);
-
-        CroixClass::CroixClassInstance* inst = dynamic_cast<CroixClass::CroixClassInstance*>(lhs);
+    __attribute__((noinline)) Value visitSetExpr(Set* s) {
+        CroixClass::CroixClassInstance* inst = asInstance(eval(s->object));
 
         if (inst == NULL) {
             throw RuntimeError(s->name, "Only class instances have properties.");
         }
-        Storable* newVal = eval(s->value);
-        inst->set(s->name, newVal);        
+        heap().push(inst);
+        Value newVal = eval(s->value);
+        heap().pop();
+        inst->set(s->name, newVal, s->cache);
         return newVal;
     }
 
-    Storable* visitThisExpr(This* t) {
-        return lookupVariable(t->keyword, t);
+    Value visitThisExpr(This* t) {
+        return lookupVariable(t->keyword, t->local);
     }
 
-    Storable* visitSuperExpr(Super* s) {
+    __attribute__((noinline)) Value visitSuperExpr(Super* s) {
         // ASSUMPTION: that depth will always resolve correctly
-        int depth = locals[s];
+        int depth = s->local.isGlobal() ? 0 : s->local.depth;
 
-        CroixClass* superclass = (CroixClass*) env->getAtDepth(depth, s->keyword);
-        Storable* child = env->getAtDepth(depth - 1, Token(THIS, "this", s->keyword.line));
+        // "super" is alone in its scope, and "this" takes
+        // the first slot of the method's scope inside it
+        CroixClass* superclass = (CroixClass*) env->getAt(depth, 0).asObject();
+        Value child = env->getAt(depth - 1, 0);
 
-        UserFunction* method = (UserFunction*) superclass->methods->get(s->property);
+        UserFunction* method = superclass->findMethod(s->property, s->cache);
 
-        return method->bind(child);
-    }
-
-    void showExpr(Expr* v) {
-        if (v) {
-            if (interacting)
-                cout << "\n  " << pr.print(v) << endl;
-            else
-                cout << pr.print(v) << endl;
-        }
+        return Value::object(method->bind(child));
     }
 
     string getExprString(Expr* e) {
@@ -441,154 +549,119 @@ public:
         return "";
     }
 
-    void visitExpressionStmt(Expression* e) {
+    Completion visitExpressionStmt(Expression* e) {
         if (interacting) {
-            Expr* v = dynamic_cast<Expr *>(eval(e->expr));
-            showExpr(v); 
+            Value v = eval(e->expr);
+            showValue(v); 
         } else
             eval(e->expr);
+        return NORMAL_COMPLETION;
     }
 
-    void visitPrintStmt(Print* e) {
+    Completion visitPrintStmt(Print* e) {
         if (e->expr != NULL) {
-            Storable* v = eval(e->expr);
-
-            if (v != NULL) {
-                if (v->storedType() == "Expr")
-                    showExpr(dynamic_cast<Expr *>(v));   
-                else if (v->storedType() == "Callable")
-                    cout << dynamic_cast<Callable *>(v)->toString() << endl;
-                else {
-                    cout << v->storedType() << endl;
-                }
-            }
+            printStored(this, eval(e->expr));
         } else {
             cout << endl;
         }
+        return NORMAL_COMPLETION;
     }
 
-    void visitVarStmt(Var* e) {
-        Storable* v = NULL;
+    Completion visitVarStmt(Var* e) {
+        Value v;
         if (e->initValue) {
             v = eval(e->initValue);
         } else {
-            v = new Nil();
+            v = Value::nil();
         }
 
-        env->define(e->name.lexeme, v);
+        define(e->name.symbol, v);
+        return NORMAL_COMPLETION;
     }
 
-    void visitBlockStmt(Block* e) {
-        executeBlock(e, new Environment(handler, env));
+    Completion visitBlockStmt(Block* e) {
+        return executeBlock(e, new Environment(handler, env));
     }
 
-    void visitIfStmt(If* e) {
+    Completion visitIfStmt(If* e) {
         // check condition to see if it is considered
         // truthy
-        if (isTruthy(dynamic_cast<Expr *>(eval(e->cond)))) {
-            execute(e->then);
+        if (isTruthy(eval(e->cond))) {
+            return execute(e->then);
         } else if (e->else_ != NULL){
-            execute(e->else_);
+            return execute(e->else_);
         }
+        return NORMAL_COMPLETION;
     }
 
-    void visitWhileStmt(While* e) {
-        while (isTruthy(dynamic_cast<Expr *>(eval(e->cond)))) {
-            execute(e->body);
+    Completion visitWhileStmt(While* e) {
+        while (isTruthy(eval(e->cond))) {
+            Completion done = execute(e->body);
+            if (done == BREAK_COMPLETION)
+                break;
+            if (done == RETURN_COMPLETION)
+                return done;
+
+            // continue still runs the increment of a for loop
+            if (e->increment != NULL)
+                eval(e->increment);
         }
+        return NORMAL_COMPLETION;
     }
 
-    void visitFunctionStmt(Function* e) {
+    Completion visitFunctionStmt(Function* e) {
         UserFunction* f = new UserFunction(e, env);
-        env->define(e->fnName.lexeme, (Storable*) f);
+        define(e->fnName.symbol, Value::object(f));
+        return NORMAL_COMPLETION;
     }
 
-    void visitReturnStmt(Return* e) {
-        Storable* rVal = NULL;
+    Completion visitReturnStmt(Return* e) {
+        Value rVal;
         if (e->value != NULL) rVal = eval(e->value);
 
-        throw ReturnExcept(rVal);
+        // picked up by executeBody once the blocks in between unwind
+        returned = rVal;
+        return RETURN_COMPLETION;
     }
 
-    void visitClassStmt(Class* c) {
-        Storable* super = NULL;
-        CroixClass* superclass = NULL;
-        if (c->superclass != NULL) {
-            super = eval(c->superclass);
-            // check to see if super is resolved into a CroixClass
-            superclass = dynamic_cast<CroixClass*>(super);
-
-            if (superclass == NULL) {
-                throw RuntimeError(c->superclass->name, "Superclass must be a class");
-            }
-        }
-
-        // allows class to refer to itself
-        env->define(c->name.lexeme, new Nil());
-
-        if (c->superclass != NULL) {
-            env = new Environment(env->handler, env, true);
-            env->define("super", superclass);
-        }
+    Completion visitBreakStmt(Break* b) {
+        return BREAK_COMPLETION;
+    }
 
-        Environment* methods = new Environment(NULL, NULL, true);
-        // map < string, Storable *> methods;
-        for (int i = 0; c->methods.size() > i; ++i) {
-            Function* fn = c->methods[i];
-            bool isInit = fn->fnName.lexeme == "init";
-
-            // in the case where we have a superclass, all methods in our class
-            // capture the env that has a reference to "super"
-            // and then we later pop it off
-            UserFunction* method = new UserFunction(fn, env, isInit);
-            // methods.insert(pair<string, Storable*>(fn->fnName.lexeme, method));
-            methods->define(fn->fnName.lexeme, (Storable*) method);
-        }
+    Completion visitContinueStmt(Continue* c) {
+        return CONTINUE_COMPLETION;
+    }
 
-        CroixClass* uc = new CroixClass(c->name.lexeme, superclass, methods);
-        
-        // after letting methods bind to env with reference to super,
-        // we pop off that env and return to its parent.
-        if (superclass != NULL) {
-            env = env->parent;
-        }
-        env->assign(c->name, (Storable*) uc);
+    __attribute__((noinline)) Completion visitClassStmt(Class* c) {
+        Value super;
+        if (c->superclass != NULL)
+            super = eval(c->superclass);
+        declareClass(this, c, super);
+        return NORMAL_COMPLETION;
     }
 
     void interpret(vector < Stmt* > stmts) {
+        int mark = heap().temps.size();
         try {
             for (int i = 0; i < stmts.size(); ++i) {
                 execute(stmts[i]);
             }
         } catch (RuntimeError& err) {
+            heap().temps.resize(mark);
             handler->runtimeError(err);
         }
     }
 
-    void execute(Stmt *s) {
-        s->accept(this);
+    Completion execute(Stmt *s) {
+        collectIfNeeded();
+        return visitStmt(s);
     }
 
-    void executeBlock(Block* e, Environment* scope) {
-        Environment* prev = env;
-        try {
-            // set new scope and execute statements in this scope
-            env = scope;
-            for (int i = 0; i < e->stmts.size(); ++i) {
-                execute(e->stmts[i]);
-            }
-        } catch (RuntimeError& err) {
-            // even in the case of an error, reset env
-            env = prev;
-            throw err;
-        } catch (ReturnExcept r) { 
-            // cause of the dumbest/best 1 off error I have ever experienced in my life
-            // I forgot to reset the environment before returning higher up the nested 
-            // environment path. I fucking hate C++ pointers. Fuckkkkkkkkkkkkkkkkkkkkk
-            env = prev;
-            throw r;
-        }
+    Value executeBody(Block* body, Environment* scope) {
+        return bodyResult(executeBlock(body, scope));
+    }
 
-        env = prev;
+    Completion executeBlock(Block* e, Environment* scope) {
+        return executeIn(this, e->stmts, scope);
     }
 };
\ No newline at end of file
@@ -11,75 +11,72 @@
 #include <vector>
 #include <string> 
 #include <stdexcept>
+#include <string.h>
 #include "../AST/TokenTypes.h"
 #include "../AST/Token.h"
 #include "../Helpers/ErrHandler.h"
-#include <map>
+#include "Scan.h"
 
 using namespace std;
 
+// lexes on demand: each call to next() scans just far enough
+// to produce one more token, so the whole token list never
+// has to exist at once
 class Lexer {
 public:
-    Lexer(string src, ErrHandler* h) {
-        source = src;
-        start = current = 0;
-        line = 1;
-        eReporter = h;
+    // text is added to sourceBuffer() as it is, so it has to stay
+    // put for as long as the tokens made from it are around
+    Lexer(const char* text, uint32_t length, ErrHandler* h) {
+        init(text, length, sourceBuffer().add(text, length), 1, &symbols(), h);
+    }
 
-        const string sKeywords[] = {
-            "and",
-            "class",
-            "else",
-            "false",
-            "for",
-            "fun",
-            "if",
-            "nil",
-            "or",
-            "print",
-            "return",
-            "super",
-            "this",
-            "true",
-            "var",
-            "while"
-        };
-
-        TokenType tKeywords[] = {
-            AND,
-            CLASS,
-            ELSE,
-            FALSE_,
-            FOR,
-            FUN,
-            IF,
-            NIL,
-            OR,
-            PRINT,
-            RETURN,
-            SUPER,
-            THIS,
-            TRUE_,
-            VAR,
-            WHILE
-        };
-        
-        int length = sizeof(sKeywords)/sizeof(sKeywords[0]);
-        for (int i = 0; i < length; ++i) {
-            keywords.insert(pair < string, TokenType >(sKeywords[i], tKeywords[i]));
-        }
+    // lexes text that is already in sourceBuffer() at base, starting
+    // on line, with names interned in names. errors are only counted
+    // when h is NULL (see ParallelLexer.h)
+    Lexer(const char* text, uint32_t length, uint32_t base, int line, SymbolTable* names, ErrHandler* h) {
+        init(text, length, base, line, names, h);
     }
 
     bool isAtEnd() {
-        return current >= source.length();
+        return current >= length;
     }
 
-    vector < Token > lexTokens() {
+    // the next token, or EOF_ (again and again) once all of it is lexed
+    Token next() {
+        if (!lexed.empty()) {
+            if (replayed + 1 < lexed.size()) {
+                tokenCount++;
+                return lexed[replayed++];
+            }
+            return lexed.back(); // EOF_
+        }
+
         while (!isAtEnd()) {
             start = current; // reposition start for next token
+            produced = false;
             lexToken(); // lex next token
+            if (produced) {
+                tokenCount++;
+                return token;
+            }
         }
-        tokens.push_back(Token(EOF_, "", line));
+        return Token(EOF_, line);
+    }
+
+    // makes next() hand out tokens (ending in EOF_) that were
+    // already lexed from this source, instead of lexing it
+    void replay(vector < Token >& tokens) {
+        lexed.swap(tokens);
+        replayed = 0;
+        current = length;
+    }
+
+    // every token up to and including EOF_
+    vector < Token > lexTokens() {
+        vector < Token > tokens;
+        do {
+            tokens.push_back(next());
+        } while (tokens.back().type != EOF_);
         return tokens;
     }
 
@@ -146,8 +143,10 @@ public:
             case ' ':
             case '\r':
             case '\t':
+            case '\n':
+                current--;
+                skip<WHITESPACE>();
                 break;
-            case '\n': line++; break;
             case '"': lexString(); break;
             default: {
                 if (isdigit(c))
@@ -155,7 +154,7 @@ public:
                 else if (isAlpha(c))
                     lexIdentifierOrKeyword();
                 else
-                    eReporter->error(line, "Unexpected character -> " + string(1, c)); 
+                    error("Unexpected character -> " + string(1, c));
                 break;
             }
         }
@@ -168,20 +167,61 @@ public:
     }
 
     void lexIdentifierOrKeyword() {
-        while (isalnum(peek())) advanceCurrent();
-
-        string text = source.substr(start, current-start);
-        map < string, TokenType >::iterator it;
-        it = keywords.find(text);
-
-        TokenType type;
-        // it is actually a keyword
-        if (it != keywords.end()) {
-            type = it->second;
-        } else { // it is not a keyword, but an identifier
-            type = IDENTIFIER;
-        }
+        skip<ALNUM>();
+
+        TokenType type = keywordType(source + start, current - start);
         addToken(type);
+        // names are interned while they are still in cache, so nothing
+        // after the lexer compares them as strings
+        if (type == IDENTIFIER || type == THIS || type == SUPER) {
+            uint32_t length = current - start;
+            token.symbol = names->intern(source + start, length, hashName(source + start, length));
+        }
+    }
+
+    // the keyword text spells, or IDENTIFIER. a switch on the first
+    // character (and the second, where keywords share one) narrows it
+    // to at most one keyword, which is then compared whole
+    static TokenType keywordType(const char* text, int length) {
+        switch (text[0]) {
+            case 'a': return keywordRest(text, length, "and", AND);
+            case 'b': return keywordRest(text, length, "break", BREAK);
+            case 'c': {
+                if (length > 1 && text[1] == 'l') return keywordRest(text, length, "class", CLASS);
+                return keywordRest(text, length, "continue", CONTINUE);
+            }
+            case 'e': return keywordRest(text, length, "else", ELSE);
+            case 'f': {
+                if (length > 1) {
+                    switch (text[1]) {
+                        case 'a': return keywordRest(text, length, "false", FALSE_);
+                        case 'o': return keywordRest(text, length, "for", FOR);
+                        case 'u': return keywordRest(text, length, "fun", FUN);
+                    }
+                }
+                return IDENTIFIER;
+            }
+            case 'i': return keywordRest(text, length, "if", IF);
+            case 'n': return keywordRest(text, length, "nil", NIL);
+            case 'o': return keywordRest(text, length, "or", OR);
+            case 'p': return keywordRest(text, length, "print", PRINT);
+            case 'r': return keywordRest(text, length, "return", RETURN);
+            case 's': return keywordRest(text, length, "super", SUPER);
+            case 't': {
+                if (length > 1 && text[1] == 'h') return keywordRest(text, length, "this", THIS);
+                return keywordRest(text, length, "true", TRUE_);
+            }
+            case 'v': return keywordRest(text, length, "var", VAR);
+            case 'w': return keywordRest(text, length, "while", WHILE);
+        }
+        return IDENTIFIER;
+    }
+
+    // type if text is exactly keyword, else IDENTIFIER
+    static TokenType keywordRest(const char* text, int length, const char* keyword, TokenType type) {
+        if (length == strlen(keyword) && memcmp(text, keyword, length) == 0)
+            return type;
+        return IDENTIFIER;
     }
 
     void lexNumber() {
@@ -199,28 +239,26 @@ public:
 
         // make sure we can convert this to a valid
         // double later
-        string numSlice = source.substr(start, current-start);
+        string numSlice(source + start, current - start);
         double d = 0;
         try {
             d = stod(numSlice);
         } catch (const invalid_argument&) {
-            eReporter->error(line, numSlice + " is an invalid number.");
+            error(numSlice + " is an invalid number.");
             return;
         } catch (const out_of_range&) {
-            eReporter->error(line, numSlice + " is out of range of a double.");
+            error(numSlice + " is out of range of a double.");
             return;
         }
         addToken(NUMBER);
     }
 
     void lexString() {
-        while (peek() != '"' && !isAtEnd()) {
-            if (peek() == '\n') line++;
-            advanceCurrent();
-        }
+        skip<TO_QUOTE>();
 
         if (isAtEnd()) {
-            eReporter->error(line, "Unterminated string.");
+            unterminated = true;
+            error("Unterminated string.");
             return;
         }
 
@@ -239,7 +277,7 @@ public:
     // characters, we use current + 1 to let us peek 2 characters
     // ahead
     char peekNext() {
-        if (current + 1 >= source.length()) return '\0';
+        if (current + 1 >= length) return '\0';
         return source[current+1];
     }
 
@@ -257,8 +295,21 @@ public:
 
     // skips a single line comment
     void skipSingleLineComment() {
-        while (peek() != '\n' && !isAtEnd()) 
-            advanceCurrent();
+        skip<TO_NEWLINE>();
+    }
+
+    // moves current past the KIND span it is at (see Scan.h),
+    // keeping line and lineStart up to date
+    template < int KIND >
+    void skip() {
+        int newlines = 0;
+        const char* lastNewline = NULL;
+        current = scan<KIND>(source + current, source + length, newlines, lastNewline) - source;
+
+        if (newlines > 0) {
+            line += newlines;
+            lineStart = lastNewline + 1 - source;
+        }
     }
 
     // advances the current token by one
@@ -268,22 +319,66 @@ public:
         return source[current - 1];
     }
 
-    // adds a token to vector
+    // makes t the token next() hands out
     void addToken(TokenType t) {
-        string snippet;
+        int column = start - lineStart + 1;
         // skip the "" from both directions
         if (t == STRING)
-            snippet = source.substr(start+1, current-start-2);
+            token = Token(t, base + start + 1, current - start - 2, line, column);
         else
-            snippet = source.substr(start, current-start);
-        tokens.push_back(Token(t, snippet, line));
+            token = Token(t, base + start, current - start, line, column);
+        produced = true;
     }
 
+    void error(string msg) {
+        hadError = true;
+        errors++;
+        if (eReporter != NULL)
+            eReporter->error(line, msg);
+    }
+
+    // where source starts in sourceBuffer()
+    uint32_t sourceBase() {
+        return base;
+    }
+
+    // the line lexing has reached
+    int lineNumber() {
+        return line;
+    }
+
+    bool hadError; // some lexing error was reported
+    int errors; // how many
+    bool unterminated; // the source ends inside a string
+    int tokenCount; // handed out so far, not counting EOF_
+
 private:
-    int start, current, line;
-    string source;
-    vector < Token > tokens;
+    void init(const char* text, uint32_t length, uint32_t base, int line, SymbolTable* names, ErrHandler* h) {
+        source = text;
+        this->length = length;
+        this->base = base;
+        start = current = lineStart = 0;
+        this->line = line;
+        this->names = names;
+        eReporter = h;
+        produced = false;
+        hadError = false;
+        errors = 0;
+        unterminated = false;
+        tokenCount = 0;
+        replayed = 0;
+    }
+
+    const char* source;
+    uint32_t length;
+    uint32_t base; // where source starts in sourceBuffer()
+    uint32_t start, current, lineStart; // offsets into source
+    int line;
+    Token token; // the one lexToken() just made, if produced
+    bool produced;
+    SymbolTable* names; // where identifiers are interned
     ErrHandler* eReporter;
-    map < string, TokenType > keywords;
+    vector < Token > lexed; // see replay()
+    size_t replayed; // how many of lexed next() has handed out
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <string.h>
+#include "Lexer.h"
+
+using namespace std;
+
+// one piece of a script, lexed on a thread of its own. pieces start
+// right after a newline, so the only token that can run into the next
+// piece is a string (which may span lines)
+class LexChunk {
+public:
+    LexChunk(uint32_t s, uint32_t e) {
+        start = s;
+        end = e;
+        newlines = 0;
+        unterminated = false;
+        failed = false;
+    }
+
+    // lexes text[start, end) as though a line began there. lines
+    // are counted from 1 and names are interned in the chunk's own
+    // table, since neither is known (or safe to share) until stitching
+    void lex(const char* text, uint32_t base) {
+        Lexer lexer(text + start, end - start, base + start, 1, &names, NULL);
+        for (Token t = lexer.next(); t.type != EOF_; t = lexer.next()) {
+            tokens.push_back(t);
+        }
+        newlines = lexer.lineNumber() - 1;
+        unterminated = lexer.unterminated;
+        // an open string at the end may only be a string going on
+        // into the next chunk. anything else is a real error
+        failed = lexer.errors > (unterminated ? 1 : 0);
+    }
+
+    uint32_t start, end; // offsets into the script
+    int newlines;
+    bool unterminated; // ends inside a string
+    bool failed;
+    vector < Token > tokens;
+    SymbolTable names;
+};
+
+// lexes a whole script on up to threads threads, in chunks of at least
+// minChunk bytes, into tokens (ending in EOF_) the same as lexing it
+// serially would. text is already in sourceBuffer() at base. returns
+// false, with tokens left empty, when the script should be lexed serially
+// instead: it is too small to split, or it has lexing errors (which the
+// serial lexer then reports, in order)
+bool lexParallel(const char* text, uint32_t length, uint32_t base, int threads,
+                 vector < Token >& tokens, uint32_t minChunk=1 << 18) {
+    // split after the first newline past each even share of the text
+    vector < LexChunk > chunks;
+    uint32_t share = length / threads;
+    if (share < minChunk)
+        share = minChunk;
+    uint32_t start = 0;
+    while (start < length) {
+        uint32_t end = length;
+        if (length - start > share) {
+            const char* nl = (const char*) memchr(text + start + share, '\n', length - start - share);
+            if (nl != NULL)
+                end = nl + 1 - text;
+        }
+        chunks.push_back(LexChunk(start, end));
+        start = end;
+    }
+    if (chunks.size() < 2)
+        return false;
+
+    // the first chunk is lexed here, the rest on threads of their own
+    vector < thread > workers;
+    for (int i = 1; i < chunks.size(); ++i) {
+        workers.push_back(thread(&LexChunk::lex, &chunks[i], text, base));
+    }
+    chunks[0].lex(text, base);
+    for (int i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+
+    // stitch the chunks back together in order, moving their tokens
+    // to the lines they are really on and their names into symbols()
+    int line = 1; // the line chunks[i] starts on
+    for (int i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].unterminated && i + 1 < chunks.size()) {
+            // a string left open runs on into the chunks after it, so
+            // those were lexed from the middle of a string. chunk i is lexed
+            // again along with as many more as it takes to close the string
+            int last = i + 1;
+            while (true) {
+                Lexer lexer(text + chunks[i].start, chunks[last].end - chunks[i].start,
+                            base + chunks[i].start, line, &symbols(), NULL);
+                vector < Token > redone = lexer.lexTokens();
+                if (lexer.unterminated && last + 1 < chunks.size()) {
+                    last++;
+                    continue;
+                }
+                if (lexer.hadError) {
+                    tokens.clear();
+                    return false;
+                }
+                tokens.insert(tokens.end(), redone.begin(), redone.end() - 1);
+                line = lexer.lineNumber();
+                break;
+            }
+            i = last;
+            continue;
+        }
+
+        LexChunk& c = chunks[i];
+        if (c.failed || c.unterminated) {
+            tokens.clear();
+            return false;
+        }
+
+        // the chunk's names in the order it first saw them, which
+        // is the order serial lexing would have interned them in
+        vector < Symbol > global(c.names.count() + 1, 0);
+        for (Symbol s = 1; s < global.size(); ++s) {
+            const string& name = c.names.name(s);
+            global[s] = symbols().intern(name.data(), name.size(), c.names.hash(s));
+        }
+        for (int t = 0; t < c.tokens.size(); ++t) {
+            Token& token = c.tokens[t];
+            token.line += line - 1;
+            token.symbol = global[token.symbol];
+            tokens.push_back(token);
+        }
+        line += c.newlines;
+    }
+    tokens.push_back(Token(EOF_, line));
+    return true;
+}
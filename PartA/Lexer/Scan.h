@@ -0,0 +1,167 @@
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CROIX_X86_SIMD
+#endif
+
+using namespace std;
+
+// the spans the Lexer skips over in one go. a run of WHITESPACE or
+// ALNUM ends at the first byte outside that class, while a
+// TO_NEWLINE or TO_QUOTE span ends at the first '\n' or '"'
+enum ScanKind { WHITESPACE, ALNUM, TO_NEWLINE, TO_QUOTE };
+
+// how wide a scan can go on this CPU. picked once at startup,
+// but it can be set to SCALAR (crx --no-simd) to compare
+enum SimdLevel { SCALAR, SSE2, AVX2 };
+
+SimdLevel& simdLevel() {
+#ifdef CROIX_X86_SIMD
+    static SimdLevel level = __builtin_cpu_supports("avx2") ? AVX2 : SSE2;
+#else
+    static SimdLevel level = SCALAR;
+#endif
+    return level;
+}
+
+bool inScanClass(int kind, char c) {
+    switch (kind) {
+        case WHITESPACE: return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        case ALNUM: return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+        case TO_NEWLINE: return c != '\n';
+        default: return c != '"';
+    }
+}
+
+// one byte at a time, for the tail of the buffer (and CPUs without SIMD)
+template < int KIND >
+const char* scanScalar(const char* p, const char* end, int& newlines, const char*& lastNewline) {
+    while (p < end && inScanClass(KIND, *p)) {
+        if (*p == '\n') {
+            newlines++;
+            lastNewline = p;
+        }
+        p++;
+    }
+    return p;
+}
+
+#ifdef CROIX_X86_SIMD
+
+// adds the newlines flagged in mask (bit i is p[i]) to the count
+inline void countNewlines(uint32_t mask, const char* p, int& newlines, const char*& lastNewline) {
+    if (mask == 0)
+        return;
+    newlines += __builtin_popcount(mask);
+    lastNewline = p + 31 - __builtin_clz(mask);
+}
+
+// bit i is set when byte i of v ends a KIND span
+template < int KIND >
+__attribute__((target("sse2")))
+inline uint32_t stopMask16(__m128i v, __m128i nl) {
+    if (KIND == TO_NEWLINE)
+        return _mm_movemask_epi8(nl);
+    if (KIND == TO_QUOTE)
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+
+    __m128i in;
+    if (KIND == WHITESPACE) {
+        in = _mm_or_si128(nl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+        in = _mm_or_si128(in, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        in = _mm_or_si128(in, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    } else {
+        // bytes past 0x7f are negative here, so they fall outside both ranges
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                       _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                      _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+        in = _mm_or_si128(letter, digit);
+    }
+    return ~_mm_movemask_epi8(in) & 0xffff;
+}
+
+template < int KIND >
+__attribute__((target("sse2")))
+const char* scanSse2(const char* p, const char* end, int& newlines, const char*& lastNewline) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        __m128i nl = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        uint32_t stop = stopMask16<KIND>(v, nl);
+        uint32_t lines = _mm_movemask_epi8(nl);
+
+        if (stop != 0) {
+            int at = __builtin_ctz(stop);
+            countNewlines(lines & ((1u << at) - 1), p, newlines, lastNewline);
+            return p + at;
+        }
+        countNewlines(lines, p, newlines, lastNewline);
+        p += 16;
+    }
+    return scanScalar<KIND>(p, end, newlines, lastNewline);
+}
+
+// the same as stopMask16, 32 bytes at a time
+template < int KIND >
+__attribute__((target("avx2")))
+inline uint32_t stopMask32(__m256i v, __m256i nl) {
+    if (KIND == TO_NEWLINE)
+        return _mm256_movemask_epi8(nl);
+    if (KIND == TO_QUOTE)
+        return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+
+    __m256i in;
+    if (KIND == WHITESPACE) {
+        in = _mm256_or_si256(nl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+        in = _mm256_or_si256(in, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        in = _mm256_or_si256(in, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    } else {
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                          _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        in = _mm256_or_si256(letter, digit);
+    }
+    return ~(uint32_t) _mm256_movemask_epi8(in);
+}
+
+template < int KIND >
+__attribute__((target("avx2")))
+const char* scanAvx2(const char* p, const char* end, int& newlines, const char*& lastNewline) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) p);
+        __m256i nl = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+        uint32_t stop = stopMask32<KIND>(v, nl);
+        uint32_t lines = _mm256_movemask_epi8(nl);
+
+        if (stop != 0) {
+            int at = __builtin_ctz(stop);
+            countNewlines(at == 0 ? 0 : lines & (0xffffffffu >> (32 - at)), p, newlines, lastNewline);
+            return p + at;
+        }
+        countNewlines(lines, p, newlines, lastNewline);
+        p += 32;
+    }
+    return scanSse2<KIND>(p, end, newlines, lastNewline);
+}
+
+#endif
+
+// skips the KIND span starting at p (stopping at end at the latest) and
+// returns where it stops. newlines counts the '\n's skipped and
+// lastNewline is left at the last of them, for line and column numbers
+template < int KIND >
+const char* scan(const char* p, const char* end, int& newlines, const char*& lastNewline) {
+#ifdef CROIX_X86_SIMD
+    if (simdLevel() == AVX2)
+        return scanAvx2<KIND>(p, end, newlines, lastNewline);
+    if (simdLevel() == SSE2)
+        return scanSse2<KIND>(p, end, newlines, lastNewline);
+#endif
+    return scanScalar<KIND>(p, end, newlines, lastNewline);
+}
@@ -7,6 +7,8 @@
 #include "../AST/Expr.h"
 #include "../AST/Stmt.h"
 #include "../Helpers/ErrHandler.h"
+#include "../Lexer/Lexer.h"
+#include "../AST/LazyBody.h"
 #include <vector>
 
 using namespace std;
@@ -20,11 +22,59 @@ double stringToDouble(string n) {
     return dN;
 }
 
+// how tightly an operator binds its operands, loosest first
+enum Precedence {
+    PREC_NONE,
+    PREC_COMMA,       // ,
+    PREC_ASSIGNMENT,  // =
+    PREC_OR,          // or
+    PREC_AND,         // and
+    PREC_TERNARY,     // ? :
+    PREC_EQUALITY,    // == !=
+    PREC_COMPARISON,  // > >= < <=
+    PREC_TERM,        // + -
+    PREC_FACTOR,      // * / ^
+    PREC_UNARY,       // ! -
+    PREC_CALL         // () .
+};
+
+// the precedence of each token as an infix (or postfix) operator,
+// in the order of TokenTypes.h. PREC_NONE never continues an expression
+const Precedence INFIX_PRECEDENCE[] = {
+    // LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE
+    PREC_CALL, PREC_NONE, PREC_NONE, PREC_NONE,
+    // COMMA, DOT, MINUS, PLUS, SEMICOLON, SLASH, MULT, EXPONENT
+    PREC_COMMA, PREC_CALL, PREC_TERM, PREC_TERM, PREC_NONE, PREC_FACTOR, PREC_FACTOR, PREC_FACTOR,
+    // COLON, QUESTION_MARK
+    PREC_NONE, PREC_TERNARY,
+    // NOT, NOT_EQUAL, EQUAL, EQUAL_EQUAL, GREATER
+    PREC_NONE, PREC_EQUALITY, PREC_ASSIGNMENT, PREC_EQUALITY, PREC_COMPARISON,
+    // GREATER_EQUAL, LESS, LESS_EQUAL
+    PREC_COMPARISON, PREC_COMPARISON, PREC_COMPARISON,
+    // IDENTIFIER, STRING, NUMBER
+    PREC_NONE, PREC_NONE, PREC_NONE,
+    // AND, CLASS, ELSE, TRUE_, FALSE_, FUN, FOR, IF, NIL
+    PREC_AND, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE,
+    // OR, PRINT, RETURN, SUPER, THIS, VAR, WHILE, BREAK, CONTINUE
+    PREC_OR, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE, PREC_NONE,
+    // EOF_
+    PREC_NONE
+};
+static_assert(sizeof(INFIX_PRECEDENCE) / sizeof(Precedence) == EOF_ + 1, "one precedence per TokenType");
+
 class Parser {
 public:
-    Parser(vector < Token > ts, ErrHandler* e) {
-        tokens = ts;
+    // tokens are pulled from lexer as parsing reaches them,
+    // and every node is made in arena
+    Parser(Lexer* lexer, ErrHandler* e, Arena* arena) {
+        this->lexer = lexer;
+        this->arena = arena;
+        declaredCallables = false;
+        lazy = false;
+        lazyFunctions = 0;
+        nesting = 0;
         tokensIndex = 0;
+        tokensLexed = 0;
         err = e;
     }
 
@@ -32,6 +82,7 @@ public:
     vector < Stmt* > parse() {
         vector < Stmt* > stmts;
         while (!isAtEnd()) {
+            nesting = 0;
             Stmt* s = declaration();
             if (s) {
                 stmts.push_back(s);
@@ -39,6 +90,22 @@ public:
         }
         return stmts;
     }
+
+    // the body of a lazily parsed function, from its '{' on
+    Block* body() {
+        consume(LEFT_BRACE, "Expected '{' before function body.");
+        return new (*arena) Block(block());
+    }
+
+    // some function or class was parsed. what the program makes of
+    // those points into the arena, so it has to outlive the run
+    bool declaredCallables;
+
+    // parse the bodies of top level functions (and of methods of top
+    // level classes) lazily. only their braces are matched now, and
+    // nothing is kept of them except where they are (see LazyBody)
+    bool lazy;
+    int lazyFunctions; // parsed lazily so far
     
 private:
     // this handles variable declarations
@@ -63,14 +130,14 @@ private:
         // we are inheriting from someone
         if (match(LESS)) {
             consume(IDENTIFIER, "Expected superclass name.");
-            superclass = new Variable(previous());
+            superclass = new (*arena) Variable(previous());
         }
 
         consume(LEFT_BRACE, "Expected '{' before class body.");
         vector < Function* > methods;
 
         while(!check(RIGHT_BRACE) && !isAtEnd()) {
-            Function* fn = dynamic_cast<Function *>(funcDeclaration("method"));
+            Function* fn = static_cast<Function *>(funcDeclaration("method"));
             
             if (fn != NULL) {
                 methods.push_back(fn);
@@ -78,7 +145,13 @@ private:
         }
 
         consume(RIGHT_BRACE, "Expected '}' to terminate class body.");
-        return new Class(name, superclass, methods);
+        declaredCallables = true;
+        Class* c = new (*arena) Class(name, superclass, methods);
+        for (int i = 0; i < methods.size(); ++i) {
+            if (methods[i]->lazy != NULL)
+                methods[i]->lazy->owner = c;
+        }
+        return c;
     }
 
     Stmt* funcDeclaration(string kind) {
@@ -99,8 +172,35 @@ private:
         consume(RIGHT_PAREN, "Expected ')' after parameters.");
 
         consume(LEFT_BRACE, "Expected '{' before " + kind + " body.");
+        declaredCallables = true;
+        if (lazy && nesting == 0)
+            return lazyFunction(fnName, params);
         vector < Stmt* > body = block();
-        return new Function(fnName, params, new Block(body));
+        return new (*arena) Function(fnName, params, new (*arena) Block(body));
+    }
+
+    // a function with its body left unparsed. the body's tokens are
+    // only counted through to the '}' matching the '{' just consumed, so
+    // all that is checked now is that it lexes and its braces balance.
+    // the rest is checked when it is parsed, on its first call
+    Function* lazyFunction(Token fnName, vector < Token >& params) {
+        Token open = previous();
+        int depth = 1;
+        while (depth > 0) {
+            if (isAtEnd())
+                throw error(peek(), "Expected '}' to terminate block.");
+            TokenType type = advanceIndex().type;
+            if (type == LEFT_BRACE)
+                depth++;
+            else if (type == RIGHT_BRACE)
+                depth--;
+        }
+
+        Token& close = previous();
+        lazyFunctions++;
+        Function* f = new (*arena) Function(fnName, params, NULL);
+        f->lazy = new (*arena) LazyBody(open.offset, close.offset + close.length - open.offset, open.line, arena);
+        return f;
     }
 
     // Stmt* lambdaDeclaration(string kind) {
@@ -129,7 +229,7 @@ private:
             init = expression();
         
         consume(SEMICOLON, "Expected ';' to terminate variable declaration.");
-        return new Var(variableName, init);
+        return new (*arena) Var(variableName, init);
     }
 
     // describes the statement types in this language
@@ -138,20 +238,24 @@ private:
         if (match(PRINT)) return printStatement();
         if (match(WHILE)) return whileStatement();
         if (match(FOR)) return forStatement();
-        if (match(LEFT_BRACE)) return new Block(block());
+        if (match(LEFT_BRACE)) return new (*arena) Block(block());
         if (match(RETURN)) return returnStatement();
+        if (match(BREAK)) return breakStatement();
+        if (match(CONTINUE)) return continueStatement();
         return expressionStatement();
     }
 
     vector < Stmt* > block() {
         vector < Stmt * > stmts;
 
+        nesting++;
         while(!check(RIGHT_BRACE) && !isAtEnd()) {
             // this allows variable bindings among other
             // statement types in blocks
             stmts.push_back(declaration());
         }
         consume(RIGHT_BRACE, "Expected '}' to terminate block.");
+        nesting--;
         return stmts;
     }
 
@@ -162,7 +266,19 @@ private:
             val = expression();
         }
         consume(SEMICOLON, "Expected ';' after return value.");
-        return new Return(ret, val);
+        return new (*arena) Return(ret, val);
+    }
+
+    Stmt* breakStatement() {
+        Token keyword = previous();
+        consume(SEMICOLON, "Expected ';' after 'break'.");
+        return new (*arena) Break(keyword);
+    }
+
+    Stmt* continueStatement() {
+        Token keyword = previous();
+        consume(SEMICOLON, "Expected ';' after 'continue'.");
+        return new (*arena) Continue(keyword);
     }
 
     // for '(' (varDecl | exprStmt | ';') expression?1 ';' expression?2 ')' Stmt
@@ -200,21 +316,12 @@ private:
         // for (a?; b?; c?) d becomes:
         // {
         //      a?;
-        //      while (b? | true) {
-        //          d;
-        //          c?;
-        //      }
+        //      while (b? | true) d; (running c? after d, even on continue)
         // }
 
-        // first, add increment statement to end of body and put them into a block statement
-        vector < Stmt* > stmts;
-        stmts.push_back(body);
-        stmts.push_back(new Expression(increment));
-        Stmt* block = new Block(stmts);
-
-        // then construct a while loop with cond and block as its body
-        if (cond == NULL) cond = new Boolean(true);
-        Stmt* while_ = new While(cond, block);
+        // construct a while loop with cond, body and increment
+        if (cond == NULL) cond = new (*arena) Boolean(true);
+        Stmt* while_ = new (*arena) While(cond, body, increment);
 
         // finally create an enclosing block if there is an initializer
         // if there isn't, return the while statement
@@ -224,7 +331,7 @@ private:
             vector < Stmt* > desugared_for;
             desugared_for.push_back(init);
             desugared_for.push_back(while_);
-            body = new Block(desugared_for);
+            body = new (*arena) Block(desugared_for);
         }
         return body;
     }
@@ -236,7 +343,7 @@ private:
 
         Stmt* body = statement();
 
-        return new While(cond, body);
+        return new (*arena) While(cond, body, NULL);
     }
 
     Stmt* ifStatement() {
@@ -251,7 +358,7 @@ private:
         if (match(ELSE))
             else_ = statement();
 
-        return new If(cond, then, else_);
+        return new (*arena) If(cond, then, else_);
     }
 
     // print statement
@@ -264,205 +371,128 @@ private:
             consume(SEMICOLON, "Expected ';' to terminate print statement");
         }
             
-        return new Print(e);
+        return new (*arena) Print(e);
     }
 
     // expression statement
     Stmt* expressionStatement() {
         Expr *e = comma();
         consume(SEMICOLON, "Expected ';' to terminate expression statement");
-        return new Expression(e);
+        return new (*arena) Expression(e);
     }
 
 
     // read 1 expr or more separated by ,
     Expr* comma() {
-        Expr *e = expression();
-
-        // it is equally a binary operator
-        while (match(COMMA)) {
-            Token op = previous();
-            Expr *r = expression();
-            e = new Binary(e, op, r);
-        }
-
-        return e;
+        return parsePrecedence(PREC_COMMA);
     }
 
-    // PARSE HIERARCHY
-    // expression -> equality
+    // one expression, with no comma at its top level
     Expr* expression() {
-        return assignment();
-    }
-
-    // handles the modification of variables
-    Expr* assignment() {
-        // get the target of the assignment
-        // could be:
-        // variable: a = someStuff;
-        // get: a.field = someStuff;
-        Expr* target = or_();
-
-        if (match(EQUAL)) { // we are assigning
-            Token eq = previous();
-            Expr* v = assignment();
-
-            switch(target->type()) {
-                //  regular variable
-                case 'v': {
-                    Token varName = dynamic_cast<Variable *>(target)->name; 
-                    return new Assign(varName, v);
+        return parsePrecedence(PREC_ASSIGNMENT);
+    }
+
+    // an operand, then every infix or postfix operator after it that
+    // binds at least as tightly as minPrec. operators of the same
+    // precedence group to the left, except for assignment and the
+    // ternary, which nest to the right
+    Expr* parsePrecedence(Precedence minPrec) {
+        Expr* e = unary();
+
+        while (true) {
+            Precedence prec = INFIX_PRECEDENCE[peek().type];
+            if (prec < minPrec) // PREC_NONE ends the expression too
+                break;
+
+            Token op = advanceIndex();
+            switch (op.type) {
+                case LEFT_PAREN: {
+                    e = buildCallExpr(e);
+                    break;
+                }
+                case DOT: {
+                    Token name = consume(IDENTIFIER, "Expected property name after '.'");
+                    e = new (*arena) Get(e, name);
                     break;
                 }
-                // setting a field gotten from a class instance
-                case 'g': {
-                    Get* g = dynamic_cast<Get *>(target);
-                    // TODO: a set could be rewritten as:
-                    // Set(Get g, Expr* newValue) vs
-                    // Set(Expr* obj, Token name, Expr* newValue)
-                    // as Get already contains both obj and name
-                    return new Set(g->object, g->name, v);
+                case EQUAL: {
+                    e = assignment(e, op);
+                    break;
+                }
+                case QUESTION_MARK: {
+                    e = ternary(e, op);
+                    break;
+                }
+                case AND:
+                case OR: {
+                    Expr* r = parsePrecedence((Precedence) (prec + 1));
+                    e = new (*arena) Logical(e, op, r);
                     break;
                 }
                 default: {
-                    error(eq, "Cannot assign to specified target.");
+                    // the comma is equally a binary operator
+                    Expr* r = parsePrecedence((Precedence) (prec + 1));
+                    e = new (*arena) Binary(e, op, r);
+                    break;
                 }
             }
         }
 
-        return target; // we aren't assigning
-    }
-
-    Expr* or_() {
-        Expr* e = and_();
-        
-        while (match(OR)) {
-            Token op = previous();
-            Expr* r = and_();
-            e = new Logical(e, op, r);
-        }
-
         return e;
     }
 
-    Expr* and_() {
-        Expr* e = ternary();
+    // handles the modification of variables. target could be:
+    // variable: a = someStuff;
+    // get: a.field = someStuff;
+    Expr* assignment(Expr* target, Token eq) {
+        Expr* v = parsePrecedence(PREC_ASSIGNMENT);
 
-        while (match(AND)) {
-            Token op = previous();
-            Expr* r = ternary();
-            e = new Logical(e, op, r);
+        switch(target->kind) {
+            //  regular variable
+            case NODE_VARIABLE: {
+                Token varName = static_cast<Variable *>(target)->name;
+                return new (*arena) Assign(varName, v);
+            }
+            // setting a field gotten from a class instance
+            case NODE_GET: {
+                Get* g = static_cast<Get *>(target);
+                // TODO: a set could be rewritten as:
+                // Set(Get g, Expr* newValue) vs
+                // Set(Expr* obj, Token name, Expr* newValue)
+                // as Get already contains both obj and name
+                return new (*arena) Set(g->object, g->name, v);
+            }
+            default: {
+                error(eq, "Cannot assign to specified target.");
+            }
         }
 
-        return e;
+        return target; // we aren't assigning
     }
 
     // potential solution for ternary problem
     // use the comma solution, but differently
     // a ? b : c becomes:
     // Binary("?", a, Binary(":", b, c))
-    Expr* ternary() {
-        Expr* e = equality();
-
-        // we have ternary expr
-        if (match(QUESTION_MARK)) {
-            Token qm = previous();
-            Expr *m = ternary();
-
-            Token col = consume(COLON, "Expected ':' in Ternary expression.");
-            Expr *r = ternary();
-            return new Binary(
-                e, 
-                qm,
-                new Binary(
-                    m,
-                    col,
-                    r
-                )
-            );
-        }
-
-        return e;
-    }
-
-    // equality -> comparison [ ("!=", "==") comparision ]* 
-    Expr* equality() {
-        Expr* e = comparison(); // process LHS
-
-        vector < TokenType > eqTTs{
-            NOT_EQUAL,
-            EQUAL_EQUAL
-        };
-
-        // look for operators at this level of matching
-        while (matches(eqTTs)) {
-            Token op = previous(); // get the matching operator
-            Expr* r = comparison();
-            e = new Binary(e, op, r);
-        }
-
-        return e;
-    }
-
-    Expr* comparison() {
-        Expr* e = term();
-
-        vector < TokenType > c;
-        c.push_back(GREATER);
-        c.push_back(LESS);
-        c.push_back(GREATER_EQUAL);
-        c.push_back(LESS_EQUAL);
-        // vector < TokenType > c { GREATER, LESS, GREATER_EQUAL, LESS_EQUAL };
-
-        while (matches(c)) {
-            Token op = previous();
-            Expr *r = term();
-            e = new Binary(e, op, r);
-        }
-
-        return e;
-    }
-
-    Expr* term() {
-        Expr* e = factor();
-
-        vector < TokenType > ops {
-            MINUS,
-            PLUS
-        };  
-
-        while (matches(ops)) {
-            Token op = previous();
-            Expr *r = factor();
-            e = new Binary(e, op, r);
-        }
-
-        return e;
-    }
-
-    Expr* factor() {
-        Expr* e = unary();
-
-        vector < TokenType > ops;
-        ops.push_back(SLASH);
-        ops.push_back(MULT);
-        ops.push_back(EXPONENT);
-
-        while (matches(ops)) {
-            Token op = previous();
-            Expr *r = unary();
-            e = new Binary(e, op, r);
-        }
-
-        return e;
-    }
-
+    Expr* ternary(Expr* e, Token qm) {
+        Expr *m = parsePrecedence(PREC_TERNARY);
+
+        Token col = consume(COLON, "Expected ':' in Ternary expression.");
+        Expr *r = parsePrecedence(PREC_TERNARY);
+        return new (*arena) Binary(
+            e, 
+            qm,
+            new (*arena) Binary(
+                m,
+                col,
+                r
+            )
+        );
+    }
+
+    // an operand: a unary operation, or a primary expression
+    // along with any calls and property gets that follow it
     Expr* unary() {
-        vector < TokenType > ops {
-            NOT,
-            MINUS
-        };
-
         // string msg = "Binary operator "
         // report binary operators error
         switch (peek().type) {
@@ -479,43 +509,20 @@ private:
                 // consume()
                 Token errOp = peek();
                 advanceIndex();
-                unary(); // parse and discard rest of operand
-                throw error(errOp, "Misused Binary operator " + errOp.lexeme + ".");
+                parsePrecedence(PREC_UNARY); // parse and discard rest of operand
+                throw error(errOp, "Misused Binary operator " + errOp.lexeme() + ".");
             }
-            default: {
-                break;
+            case NOT:
+            case MINUS: {
+                Token op = advanceIndex();
+                Expr* r = parsePrecedence(PREC_UNARY);
+                return new (*arena) Unary(op, r);
             }
-        }
-
-        if (matches(ops)) {
-            Token op = previous();
-            Expr* r = unary();
-            return new Unary(op, r);
-        }
-
-        // not a unary operation so match call or primary Exprs
-        return call();
-    }
-
-    Expr* call() {
-        Expr* e = primary();
-
-        // while (match(LEFT_PAREN)) {
-        //     e = buildCallExpr(e);
-        // }
-
-        // Nystrom's version
-        while (true) {
-            if (match(LEFT_PAREN))
-                e = buildCallExpr(e);
-            else if (match(DOT)) {
-                Token name = consume(IDENTIFIER, "Expected property name after '.'");
-                e = new Get(e, name);
+            default: {
+                // not a unary operation so match primary Exprs
+                return primary();
             }
-            else
-                break;
         }
-        return e;
     }
 
     Expr* buildCallExpr(Expr* callable) {
@@ -532,7 +539,7 @@ private:
 
         // use this closing operator to report errors
         Token op = consume(RIGHT_PAREN, "Expected ')' after arguments.");
-        return new Call(callable, op, arguments);
+        return new (*arena) Call(callable, op, arguments);
     }
 
     Expr* primary() {
@@ -541,46 +548,46 @@ private:
             // versions
             case TRUE_: {
                 advanceIndex();
-                return new Boolean(true);
+                return new (*arena) Boolean(true);
                 break;
             }
             case FALSE_: {
                 advanceIndex();
-                return new Boolean(false);
+                return new (*arena) Boolean(false);
                 break;
             }
             case NUMBER: {
                 advanceIndex();
-                string nStr = previous().lexeme;
+                string nStr = previous().lexeme();
                 double n = stringToDouble(nStr);
-                return new Number(n);
+                return new (*arena) Number(n);
                 break;
             }
             case STRING: {
                 advanceIndex();
-                return new String(previous().lexeme);
+                return new (*arena) String(previous().lexeme());
                 break;
             }
             case NIL: {
                 advanceIndex();
-                return new Nil();
+                return new (*arena) Nil();
                 break;
             }
             case LEFT_PAREN: {
                 advanceIndex();
                 Expr *e = expression();
                 consume(RIGHT_PAREN, "Expected ')' following expression.");
-                return new Grouping(e);
+                return new (*arena) Grouping(e);
                 break;
             }
             case IDENTIFIER: {
                 advanceIndex();
-                return new Variable(previous()); // get the identifier
+                return new (*arena) Variable(previous()); // get the identifier
                 break;
             }
             case THIS: {
                 advanceIndex();
-                return new This(previous());
+                return new (*arena) This(previous());
                 break;
             }
             case SUPER: {
@@ -588,11 +595,11 @@ private:
                 Token keyword = previous();
                 consume(DOT, "Expected '.' after 'super'.");
                 Token prop = consume(IDENTIFIER, "Expected superclass property name.");
-                return new Super(keyword, prop);
+                return new (*arena) Super(keyword, prop);
                 break;
             }
             default: {
-                throw error(peek(), "Expected expression, got " + peek().lexeme + ".");
+                throw error(peek(), "Expected expression, got " + peek().lexeme() + ".");
             }
 
         }
@@ -632,13 +639,16 @@ private:
     }
 
     // returns unprocessed current token
-    Token peek() {
-        return tokens[tokensIndex];
+    Token& peek() {
+        while (tokensLexed <= tokensIndex) {
+            lookahead[tokensLexed++ % LOOKAHEAD] = lexer->next();
+        }
+        return lookahead[tokensIndex % LOOKAHEAD];
     }
 
     // returns last processed token
-    Token previous() {
-        return tokens[tokensIndex - 1];
+    Token& previous() {
+        return lookahead[(tokensIndex - 1) % LOOKAHEAD];
     }
 
     // checks if we have finished parsing
@@ -648,16 +658,7 @@ private:
         return false;
     }
 
-    // checks if the current token has any of the types provided
-    bool matches(vector < TokenType > types) {
-        for (int i = 0; i < types.size(); ++i) {
-            TokenType tt = types[i];
-            if (match(tt)) return true; // use single match function   
-        }
-        return false;
-    }     
-
-    Token advanceIndex() {
+    Token& advanceIndex() {
         if (!isAtEnd()) tokensIndex++; // advance by one
         return previous(); // return recently consumed token
     }
@@ -675,18 +676,32 @@ private:
         return peek().type == t;
     }
 
-    Token consume(TokenType exp, string msg) {
+    Token& consume(TokenType exp, string msg) {
         if (check(exp)) return advanceIndex();
 
         throw error(peek(), msg);
     }
 
     ParseError error(Token t, string msg) {
-        err->error(t, msg);
+        // past a lexing error, the tokens are missing pieces and
+        // would only cause more confusing errors
+        if (!lexer->hadError)
+            err->error(t, msg);
         return ParseError();
     }
 
-    vector < Token > tokens;
-    int tokensIndex;
+    // the tokens around tokensIndex, in a ring. only the current and
+    // previous token are ever looked at, and a reference to either
+    // stays good for a few more tokens after it is handed out
+    static const int LOOKAHEAD = 4;
+    Token lookahead[LOOKAHEAD];
+    Lexer* lexer;
+    Arena* arena; // where nodes are made
+    // blocks the parser is in. only functions at nesting 0 can be parsed
+    // lazily, as nothing but the globals (and a class) is around them.
+    // a block that ends in an error leaves it too high, which is safe
+    int nesting;
+    int tokensIndex; // tokens consumed so far
+    int tokensLexed; // tokens pulled from lexer so far
     ErrHandler* err;
 };
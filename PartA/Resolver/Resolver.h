@@ -1,24 +1,72 @@
 #pragma once
 
 #include <iostream>
-#include <map>
+#include <unordered_map>
 #include <vector>
 #include "../AST/Expr.h"
 #include "../AST/Token.h"
 #include "../AST/Stmt.h"
 #include "../Helpers/ErrHandler.h"
-#include "../Interpreter/Interpreter.h"
+#include "../AST/LazyBody.h"
 
 enum FunctionType { NONE, FUNCTION, METHOD, INITIALIZER };
 enum ClassType { NOCLASS, SOMECLASS, SUBCLASS };
 
-class Resolver : public ExprVisitor<void>, public StmtVisitor<void> {
+// where a name is bound in the local scopes open right now: the scope
+// that declared it (0 is the outermost), the slot it takes in that scope
+// at runtime, and whether its initializer has been resolved
+class LocalVar {
 public:
-    Resolver(Interpreter* i, ErrHandler* handler) {
-        interpreter = i;
+    // the scope of a name no open local scope declares
+    static const int UNBOUND = -1;
+
+    LocalVar(int sc=UNBOUND, int s=0, bool d=false) {
+        scope = sc;
+        slot = s;
+        defined = d;
+    }
+
+    int scope;
+    int slot;
+    bool defined;
+};
+
+// what declaring name hid, put back when the declaring scope closes
+class Shadowed {
+public:
+    Shadowed(Symbol n, LocalVar w) {
+        name = n;
+        was = w;
+    }
+
+    Symbol name;
+    LocalVar was;
+};
+
+// an open local scope: where its declarations start in the undo log,
+// and how many names it has, which numbers the slot of the next one
+class Scope {
+public:
+    Scope(size_t from) {
+        undoFrom = from;
+        names = 0;
+    }
+
+    size_t undoFrom;
+    int names;
+};
+
+class Resolver : public ExprVisitor<Resolver, void>, public StmtVisitor<Resolver, void> {
+public:
+    // where each name is found is written into the node that names it
+    Resolver(ErrHandler* handler) {
         eHandler = handler;
         currentFunctionType = NONE;
         currentClassType = NOCLASS;
+        loopDepth = 0;
+        thisName = intern("this");
+        superName = intern("super");
+        initName = intern("init");
     }
 
     void visitVarStmt(Var* e) {
@@ -37,7 +85,7 @@ public:
 
         // make sure class is not inheriting from itself
         if (c->superclass != NULL && 
-            c->name.lexeme == c->superclass->name.lexeme) {
+            c->name.symbol == c->superclass->name.symbol) {
                 eHandler->error(c->superclass->name, "A class cannot inherit from itself.");
         }
 
@@ -50,37 +98,30 @@ public:
         // statically resolve super before methods are bound
         if (c->superclass != NULL) {
             enterScope();
-            scopes.back().insert(pair<string, bool>("super", true));
+            bind(superName);
         }
 
-        // scope used to capture "this" variable
-        enterScope();
-        scopes.back().insert(pair<string, bool>("this", true));
         // now handle resolving methods 
         for (int i = 0; c->methods.size() > i; ++i) {
             FunctionType declaration = METHOD;
-            if (c->methods[i]->fnName.lexeme == "init") {
+            if (c->methods[i]->fnName.symbol == initName) {
                 declaration = INITIALIZER;
             }
             resolveFunction(c->methods[i], declaration);
         }
-        exitScope();
         if (c->superclass != NULL) 
             exitScope();
         currentClassType = enclosing;
     }
 
     void visitVariableExpr(Variable* e) {
-        // there is some local scope, and the top scope contains the referenced name
-        if(!scopeIsEmpty() && containsKey(scopes.back(), e->name.lexeme)) {
-            map < string, bool > scope = scopes.back();
-            // we have just referenced a declared but undefined name
-            // or a variable that is shadowing a variable in an outer scope
-            if (scope.at(e->name.lexeme) == false) { 
-                eHandler->error(e->name, "Can't reference local variable in its own initializer.");
-            }
+        // the innermost scope declared the referenced name, but
+        // its initializer (which this is in) isn't resolved yet
+        LocalVar* local = boundHere(e->name.symbol);
+        if (local != NULL && !local->defined) {
+            eHandler->error(e->name, "Can't reference local variable in its own initializer.");
         }
-        resolveLocally(e, e->name);
+        resolveLocally(e->local, e->name);
     }
 
     void visitBlockStmt(Block* e) {
@@ -93,7 +134,7 @@ public:
         // handle RHS first
         resolve(e->value);
         // then handle variable name
-        resolveLocally(e, e->name);
+        resolveLocally(e->local, e->name);
     }
 
     void visitGetExpr(Get* g) {
@@ -147,7 +188,23 @@ public:
 
     void visitWhileStmt(While* w) {
         resolve(w->cond);
+        loopDepth++;
         resolve(w->body);
+        loopDepth--;
+        if (w->increment != NULL)
+            resolve(w->increment);
+    }
+
+    void visitBreakStmt(Break* b) {
+        if (loopDepth == 0) {
+            eHandler->error(b->keyword, "Can't use 'break' outside of a loop.");
+        }
+    }
+
+    void visitContinueStmt(Continue* c) {
+        if (loopDepth == 0) {
+            eHandler->error(c->keyword, "Can't use 'continue' outside of a loop.");
+        }
     }
 
     void visitBinaryExpr(Binary* b) {
@@ -194,7 +251,7 @@ public:
             eHandler->error(t->keyword, "Can't use 'this' outside of a class.");
             return;
         }
-        resolveLocally(t, t->keyword);
+        resolveLocally(t->local, t->keyword);
     }
 
     void visitSuperExpr(Super* s) {
@@ -204,83 +261,132 @@ public:
             eHandler->error(s->keyword, "Can't use 'super' in a class with no superclass.");
         }
         // resolve the "super" part
-        resolveLocally(s, s->keyword);
+        resolveLocally(s->local, s->keyword);
     }
 
-    void resolveStmts(vector < Stmt* > stmts) {
+    void resolveStmts(const vector < Stmt* >& stmts) {
         for (int i = 0; stmts.size() > i; ++i) {
             resolve(stmts[i]);
         }
     }
 
+    // resolves the body of a lazily parsed function, a method when
+    // classType isn't NOCLASS. it was declared at the top level (or in
+    // a class that was), so the only scope around it is one its class
+    // may make for super
+    void resolveLazyBody(Function* f, ClassType classType) {
+        if (classType == NOCLASS) {
+            resolveFunction(f, FUNCTION);
+            return;
+        }
+
+        currentClassType = classType;
+        if (classType == SUBCLASS) {
+            enterScope();
+            bind(superName);
+        }
+        resolveFunction(f, f->fnName.symbol == initName ? INITIALIZER : METHOD);
+        if (classType == SUBCLASS)
+            exitScope();
+        currentClassType = NOCLASS;
+    }
+
 private:
     void declare(Token name) {
         if (scopeIsEmpty()) // global variable
             return;
-        map < string, bool > &curScope = scopes.back();
         // redeclaring a variable or name is an error        
-        if (containsKey(curScope, name.lexeme)) {
+        if (boundHere(name.symbol) != NULL) {
             eHandler->error(name, "Variable with same name already exists in this scope.");
+            return;
         }
-        // initialization is incomplete, awaiting resolve,
-        // so it's set to false
-        curScope.insert(pair< string, bool >(name.lexeme, false));
+        // initialization is incomplete, awaiting resolve
+        bind(name.symbol, false);
     }
 
     void define(Token name) {
         if (scopeIsEmpty()) // global variable
             return;
-        map < string, bool > &curScope = scopes.back();
-        curScope.at(name.lexeme) = true; // successfully resolved
-        // cout << name.lexeme << " defined\n";
+        bound[name.symbol].defined = true; // successfully resolved
+    }
+
+    // binds name in the innermost scope, hiding any outer binding of it
+    // till the scope closes. names are numbered in declaration order,
+    // the same order the runtime defines them
+    void bind(Symbol name, bool defined=true) {
+        Scope& scope = scopes.back();
+        LocalVar& local = bound[name];
+        undo.push_back(Shadowed(name, local));
+        local = LocalVar(scopes.size() - 1, scope.names++, defined);
+    }
+
+    // the binding of name, if the innermost scope declared it
+    LocalVar* boundHere(Symbol name) {
+        if (scopeIsEmpty())
+            return NULL;
+        Bindings::iterator found = bound.find(name);
+        if (found == bound.end() || found->second.scope != scopes.size() - 1)
+            return NULL;
+        return &found->second;
     }
 
     void resolve(Stmt* stmt) {
-        stmt->accept(this);
+        visitStmt(stmt);
     }
 
     void resolve(Expr* e) {
-        e->accept(this);
-    }
-
-    void resolveLocally(Expr* e, Token name) {
-        for (int i = scopes.size() -1; i >= 0; --i) {
-            map < string, bool > scope = scopes[i];
-            if (containsKey(scope, name.lexeme)) {
-                // cout << "Resolving " << interpreter->getExprString(e) 
-                //     << " at depth " << scopes.size() - i - 1 << endl;
-                // cout << "total len is " << scopes.size() << endl << endl;
-                interpreter->resolve(e, scopes.size() - i - 1);
-                return;
-            }
-        }
+        visitExpr(e);
+    }
+
+    // a name no open scope binds is left to the globals
+    void resolveLocally(LocalSlot& local, Token name) {
+        if (scopeIsEmpty())
+            return;
+        Bindings::iterator found = bound.find(name.symbol);
+        if (found != bound.end() && found->second.scope != LocalVar::UNBOUND)
+            local = LocalSlot(scopes.size() - 1 - found->second.scope, found->second.slot);
     }
 
     void resolveFunction(Function* f, FunctionType funcType) {
         FunctionType enclosingFunctionType = currentFunctionType;
         currentFunctionType = funcType;
+        // loops outside the function can't be broken out of
+        int enclosingLoopDepth = loopDepth;
+        loopDepth = 0;
 
         enterScope();
+        // a method's receiver takes the slot before its parameters
+        if (funcType == METHOD || funcType == INITIALIZER)
+            bind(thisName);
         for (int i = 0; f->params.size() > i; ++i) {
             Token param = f->params[i];
             declare(param);
             define(param);
         }
-        resolve(f->body);
+        // a lazily parsed body is resolved when it is parsed
+        if (f->body != NULL)
+            resolve(f->body);
         exitScope();
         currentFunctionType = enclosingFunctionType;
+        loopDepth = enclosingLoopDepth;
     }
 
     // simulate the linked list created during runtime inside
     // interpreter, by stacking environments 
     // (but not chained in a linked list)
     void enterScope() {
-        map < string, bool > newScope;
-        scopes.push_back(newScope);
+        scopes.push_back(Scope(undo.size()));
     }
 
-    // pops top environment
+    // closes the innermost scope, putting back every
+    // binding its declarations hid, latest first
     void exitScope() {
+        size_t from = scopes.back().undoFrom;
+        while (undo.size() > from) {
+            Shadowed& last = undo.back();
+            bound[last.name] = last.was;
+            undo.pop_back();
+        }
         scopes.pop_back();
     }
 
@@ -288,22 +394,22 @@ private:
         return scopes.size() == 0;
     }
 
-    bool containsKey(map < string, bool > scope, string name) {
-        map < string, bool >::iterator elem = scope.find(name);
-
-        if (elem != scope.end())
-            return true;
-        return false;
-    }
-
     // used to check what type of function we are currently in
     FunctionType currentFunctionType; 
     ClassType currentClassType;
+    int loopDepth; // loops enclosing the code being resolved, in this function
 
-    Interpreter* interpreter;
     ErrHandler* eHandler;
     
-    // a stack of Environment scopes
-    // where an Environment is map < string, bool >
-    vector < map < string, bool> > scopes;
+    // every name's binding in the open scopes, by its interned Symbol.
+    // one table for all of them, so looking a name up costs the
+    // same however deep the scopes go
+    typedef unordered_map < Symbol, LocalVar > Bindings;
+    Bindings bound;
+    vector < Shadowed > undo; // what each open declaration hid
+    vector < Scope > scopes; // the open local scopes, innermost last
+
+    Symbol thisName;
+    Symbol superName;
+    Symbol initName;
 };
\ No newline at end of file
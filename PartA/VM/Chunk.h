@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <string.h>
+#include <stdint.h>
+#include "../AST/Expr.h"
+#include "../AST/Stmt.h"
+#include "../AST/Token.h"
+
+using namespace std;
+
+// instruction set of the VM. operands follow the opcode
+// in the byte stream, each one 2 bytes wide (big endian),
+// but for jump offsets, which are 4 bytes wide.
+// an index (into a chunk's constants, names, functions, classes or
+// sites) past 16 bits has an OP_WIDE ahead of its instruction
+enum OpCode {
+    OP_WIDE,            // [high] the high 16 bits of the next instruction's index
+    OP_CONSTANT,        // [constant] push a literal value
+    OP_NIL,             // push nil (default value of var)
+    OP_VOID,            // push the "no value" of a bare return
+    OP_POP,
+    OP_SHOW,            // pop and show the value (REPL expression statements)
+
+    OP_GET_LOCAL,       // [depth][slot]
+    OP_SET_LOCAL,       // [depth][slot]
+    OP_GET_GLOBAL,      // [name]
+    OP_SET_GLOBAL,      // [name]
+    OP_DEFINE_GLOBAL,   // [name] pop into a new global
+    OP_DEFINE_LOCAL,    // pop into the next slot of the current scope
+    OP_GET_PROPERTY,    // [get site]
+    OP_GET_METHOD,      // [get site] push a method and its receiver, or a field and no value
+    OP_SET_PROPERTY,    // [set site]
+    OP_GET_SUPER,       // [depth][super site]
+
+    OP_EQUAL, OP_NOT_EQUAL,
+    OP_GREATER, OP_GREATER_EQUAL, OP_LESS, OP_LESS_EQUAL,
+    OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_DIVIDE,
+    OP_NOT, OP_NEGATE,
+
+    OP_PRINT,           // pop and print the value
+    OP_PRINT_EMPTY,     // print;
+
+    OP_JUMP,            // [offset] forward
+    OP_JUMP_IF_FALSE,   // [offset] forward, leaves condition on the stack
+    OP_JUMP_IF_TRUE,    // [offset] forward, leaves condition on the stack
+    OP_LOOP,            // [offset] backward
+
+    OP_PUSH_SCOPE,      // enter a block
+    OP_POP_SCOPE,       // leave a block
+
+    OP_CALL,            // [argument count][call site]
+    OP_INVOKE,          // [argument count][call site] call what OP_GET_METHOD pushed
+    OP_FUNCTION,        // [function] push a closure over the current scope
+    OP_CLASS,           // [class] (superclass is on the stack if there is one)
+    OP_RETURN
+};
+
+class Chunk;
+
+// a class declaration and the compiled bodies of its methods,
+// in the same order as decl->methods
+class ClassProto {
+public:
+    ClassProto(Class* c) {
+        decl = c;
+    }
+
+    Class* decl;
+    vector < Chunk* > methods;
+};
+
+// compiled bytecode for the top level of a script
+// or for the body of a single function
+class Chunk {
+public:
+    Chunk(Function* fn=NULL) {
+        decl = fn;
+        block = NULL;
+        trueAt = -1;
+        falseAt = -1;
+    }
+
+    // the method chunks of its classes are chunks of their own,
+    // freed as every other chunk is (see Compiler::release)
+    ~Chunk() {
+        for (int i = 0; i < classes.size(); ++i) {
+            delete classes[i];
+        }
+    }
+
+    void write(uint8_t byte, int line) {
+        code.push_back(byte);
+        lines.push_back(line);
+    }
+
+    void writeShort(int operand, int line) {
+        write((operand >> 8) & 0xff, line);
+        write(operand & 0xff, line);
+    }
+
+    void writeInt(uint32_t operand, int line) {
+        writeShort(operand >> 16, line);
+        writeShort(operand & 0xffff, line);
+    }
+
+    // constants and names are added once per chunk, however
+    // often they are used in it
+
+    int addNumber(double n) {
+        uint64_t bits;
+        memcpy(&bits, &n, sizeof(double)); // keeps 0 and -0 apart
+        map < uint64_t, int >::iterator found = numberAt.find(bits);
+        if (found != numberAt.end())
+            return found->second;
+        return numberAt[bits] = addConstant(Value::number(n));
+    }
+
+    int addBoolean(bool b) {
+        int& at = b ? trueAt : falseAt;
+        if (at < 0)
+            at = addConstant(Value::boolean(b));
+        return at;
+    }
+
+    // s is only made into a runtime string the first time
+    int addString(const string& s) {
+        map < string, int >::iterator found = stringAt.find(s);
+        if (found != stringAt.end())
+            return found->second;
+        // kept alive by the VM, which marks the constants of every
+        // chunk still around (see VM::markRoots)
+        CroixString* str = new CroixString(s);
+        return stringAt[s] = addConstant(Value::object(str));
+    }
+
+    int addName(Token name) {
+        map < Symbol, int >::iterator found = nameAt.find(name.symbol);
+        if (found != nameAt.end())
+            return found->second;
+        names.push_back(name);
+        return nameAt[name.symbol] = names.size() - 1;
+    }
+
+    Function* decl; // NULL for top level code
+    Block* block; // the body compiled into it, NULL for top level code
+    vector < uint8_t > code;
+    vector < int > lines; // source line of every byte in code
+    vector < Value > constants;
+    vector < Token > names;
+    vector < Chunk* > functions;
+    vector < ClassProto* > classes;
+    // Get, Set, Call and Super nodes, whose inline caches the VM shares
+    vector < Get* > gets;
+    vector < Set* > sets;
+    vector < Call* > calls;
+    vector < Super* > supers;
+
+private:
+    int addConstant(Value value) {
+        constants.push_back(value);
+        return constants.size() - 1;
+    }
+
+    // where each constant and name already is
+    map < uint64_t, int > numberAt; // by the bits of the double
+    map < string, int > stringAt;
+    map < Symbol, int > nameAt;
+    int trueAt;
+    int falseAt;
+
+    // a chunk owns its classes, so it is never copied
+    Chunk(const Chunk&);
+    Chunk& operator=(const Chunk&);
+};
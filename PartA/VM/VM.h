@@ -0,0 +1,522 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <typeinfo>
+#include "../AST/Expr.h"
+#include "../AST/Stmt.h"
+#include "../AST/Token.h"
+#include "../AST/TokenTypes.h"
+#include "../AST/CInterpreter.h"
+#include "../AST/Callable.h"
+#include "../AST/Class.h"
+#include "../AST/Functions.h"
+#include "../Compiler/Compiler.h"
+#include "../Environment/Environment.h"
+#include "../Helpers/ErrHandler.h"
+#include "../Interpreter/Interpreter.h"
+#include "Chunk.h"
+
+using namespace std;
+
+// an active call. Croix to Croix calls push one of these
+// instead of recursing through Callable::call
+class CallFrame {
+public:
+    UserFunction* fn; // NULL for top level code and executeBody entries
+    Chunk* chunk;
+    uint8_t* ip;
+    int base; // stack size to restore on return
+    Environment* callerEnv;
+};
+
+// stack based bytecode VM. it shares Environments, Callables and
+// values with the tree-walking Interpreter, so the two engines can
+// be swapped with crx --vm
+class VM : public CInterpreter {
+public:
+    VM(ErrHandler* e, bool interactiveMode=false, Environment* globals=NULL) {
+        handler = e;
+        interacting = interactiveMode;
+
+        if (globals)
+            env = globals;
+        else
+            env = new Environment(e);
+
+        env->define(intern("clock"), Value::object(new Clock()));
+        this->globals = env;
+        wide = 0;
+    }
+
+    void interpret(vector < Stmt* > stmts) {
+        int made = Compiler::chunks().size();
+        Compiler compiler(this, handler, interacting);
+        Chunk* script = compiler.compile(stmts);
+
+        if (!handler->SOURCE_HAD_ERROR) {
+            int mark = heap().temps.size();
+            try {
+                run(script, env);
+            } catch (RuntimeError& err) {
+                stack.clear();
+                frames.clear();
+                heap().temps.resize(mark);
+                env = globals;
+                handler->runtimeError(err);
+            }
+        }
+
+        // the chunks go with the tree they were compiled from: at the
+        // end of a script, or of a REPL line with nothing to call later
+        if (!interacting || !compiler.declaredCallables)
+            Compiler::release(made);
+    }
+
+    // entry point for Callables (like class initializers)
+    // that run a function body on their own
+    Value executeBody(Block* e, Environment* scope) {
+        map < Block*, Chunk* >::iterator found = Compiler::bodies().find(e);
+        Chunk* body;
+        if (found != Compiler::bodies().end()) {
+            body = found->second;
+        } else {
+            Compiler compiler(this, handler, interacting);
+            body = compiler.compileBody(e);
+        }
+
+        return run(body, scope);
+    }
+
+    void markRoots() {
+        for (int i = 0; i < stack.size(); ++i) {
+            markValue(stack[i]);
+        }
+        for (int i = 0; i < frames.size(); ++i) {
+            heap().mark(frames[i].fn);
+            heap().mark(frames[i].callerEnv);
+        }
+        // string constants, for as long as their chunk is around
+        vector < Chunk* >& chunks = Compiler::chunks();
+        for (int i = 0; i < chunks.size(); ++i) {
+            for (int j = 0; j < chunks[i]->constants.size(); ++j) {
+                markValue(chunks[i]->constants[j]);
+            }
+        }
+    }
+
+private:
+    // runs chunk in scope till it returns, and hands back the
+    // returned value
+    Value run(Chunk* chunk, Environment* scope) {
+        int entryDepth = frames.size();
+        pushFrame(NULL, chunk, scope);
+        CallFrame* frame = &frames.back();
+
+        while (true) {
+            uint8_t instruction = *frame->ip++;
+
+            switch (instruction) {
+                case OP_WIDE: {
+                    wide = readShort(frame) << 16;
+                    break;
+                }
+                case OP_CONSTANT: {
+                    stack.push_back(frame->chunk->constants[readIndex(frame)]);
+                    break;
+                }
+                case OP_NIL: stack.push_back(Value::nil()); break;
+                case OP_VOID: stack.push_back(Value()); break;
+                case OP_POP: stack.pop_back(); break;
+                case OP_SHOW: {
+                    showValue(pop());
+                    break;
+                }
+                case OP_GET_LOCAL: {
+                    int depth = readShort(frame);
+                    stack.push_back(env->getAt(depth, readShort(frame)));
+                    break;
+                }
+                case OP_SET_LOCAL: {
+                    int depth = readShort(frame);
+                    env->assignAt(depth, readShort(frame), stack.back());
+                    break;
+                }
+                case OP_GET_GLOBAL: {
+                    Token& name = frame->chunk->names[readIndex(frame)];
+                    stack.push_back(globals->get(name));
+                    break;
+                }
+                case OP_SET_GLOBAL: {
+                    Token& name = frame->chunk->names[readIndex(frame)];
+                    globals->assign(name, stack.back());
+                    break;
+                }
+                case OP_DEFINE_GLOBAL: {
+                    Token& name = frame->chunk->names[readIndex(frame)];
+                    env->define(name.symbol, pop());
+                    break;
+                }
+                case OP_DEFINE_LOCAL: {
+                    env->defineSlot(pop());
+                    break;
+                }
+                case OP_GET_PROPERTY: {
+                    Get* site = frame->chunk->gets[readIndex(frame)];
+                    CroixClass::CroixClassInstance* inst = asInstance(pop());
+
+                    if (inst == NULL)
+                        throw RuntimeError(site->name, "Only class instances have properties.");
+                    stack.push_back(inst->get(site->name, site->cache));
+                    break;
+                }
+                case OP_GET_METHOD: {
+                    Get* site = frame->chunk->gets[readIndex(frame)];
+                    CroixClass::CroixClassInstance* inst = asInstance(stack.back());
+
+                    if (inst == NULL)
+                        throw RuntimeError(site->name, "Only class instances have properties.");
+
+                    UserFunction* method;
+                    Value field = inst->lookup(site->name, site->cache, method);
+                    if (method != NULL) {
+                        // the receiver stays above its method
+                        stack.back() = Value::object(method);
+                        stack.push_back(Value::object(inst));
+                    } else {
+                        stack.back() = inst->rebind(field);
+                        stack.push_back(Value());
+                    }
+                    break;
+                }
+                case OP_SET_PROPERTY: {
+                    Set* site = frame->chunk->sets[readIndex(frame)];
+                    Value newVal = pop();
+                    CroixClass::CroixClassInstance* inst = asInstance(pop());
+
+                    if (inst == NULL)
+                        throw RuntimeError(site->name, "Only class instances have properties.");
+                    inst->set(site->name, newVal, site->cache);
+                    stack.push_back(newVal);
+                    break;
+                }
+                case OP_GET_SUPER: {
+                    int depth = readShort(frame);
+                    Super* site = frame->chunk->supers[readIndex(frame)];
+
+                    // "super" is alone in its scope, and "this" takes
+                    // the first slot of the method's scope inside it
+                    CroixClass* superclass = (CroixClass*) env->getAt(depth, 0).asObject();
+                    Value child = env->getAt(depth - 1, 0);
+                    UserFunction* method = superclass->findMethod(site->property, site->cache);
+                    stack.push_back(Value::object(method->bind(child)));
+                    break;
+                }
+                case OP_EQUAL: {
+                    Value r = pop();
+                    Value l = pop();
+                    stack.push_back(Value::boolean(areEqual(l, r)));
+                    break;
+                }
+                case OP_NOT_EQUAL: {
+                    Value r = pop();
+                    Value l = pop();
+                    stack.push_back(Value::boolean(!areEqual(l, r)));
+                    break;
+                }
+                case OP_GREATER: {
+                    double r, l;
+                    numberOperands(frame, l, r);
+                    stack.push_back(Value::boolean(l > r));
+                    break;
+                }
+                case OP_GREATER_EQUAL: {
+                    double r, l;
+                    numberOperands(frame, l, r);
+                    stack.push_back(Value::boolean(l >= r));
+                    break;
+                }
+                case OP_LESS: {
+                    double r, l;
+                    numberOperands(frame, l, r);
+                    stack.push_back(Value::boolean(l < r));
+                    break;
+                }
+                case OP_LESS_EQUAL: {
+                    double r, l;
+                    numberOperands(frame, l, r);
+                    stack.push_back(Value::boolean(l <= r));
+                    break;
+                }
+                case OP_ADD: {
+                    Value r = pop();
+                    Value l = pop();
+                    areNumbersOrStrings(currentToken(frame), l, r);
+
+                    if (isN(l)) {
+                        stack.push_back(Value::number(l.asNumber() + r.asNumber()));
+                    } else {
+                        string rs = r.asString()->value;
+                        string ls = l.asString()->value;
+                        stack.push_back(Value::object(new CroixString(ls + rs)));
+                    }
+                    break;
+                }
+                case OP_SUBTRACT: {
+                    double r, l;
+                    numberOperands(frame, l, r);
+                    stack.push_back(Value::number(l - r));
+                    break;
+                }
+                case OP_MULTIPLY: {
+                    double r, l;
+                    numberOperands(frame, l, r);
+                    stack.push_back(Value::number(l * r));
+                    break;
+                }
+                case OP_DIVIDE: {
+                    double r, l;
+                    numberOperands(frame, l, r);
+                    if (r == 0)
+                        throw RuntimeError(currentToken(frame), "Division by Zero.");
+                    stack.push_back(Value::number(l / r));
+                    break;
+                }
+                case OP_NOT: {
+                    stack.push_back(Value::boolean(!isTruthy(pop())));
+                    break;
+                }
+                case OP_NEGATE: {
+                    Value r = pop();
+                    isNumber(currentToken(frame), r);
+                    stack.push_back(Value::number(-r.asNumber()));
+                    break;
+                }
+                case OP_PRINT: {
+                    printStored(this, pop());
+                    break;
+                }
+                case OP_PRINT_EMPTY: {
+                    cout << endl;
+                    break;
+                }
+                case OP_JUMP: {
+                    uint32_t offset = readOffset(frame);
+                    frame->ip += offset;
+                    break;
+                }
+                case OP_JUMP_IF_FALSE: {
+                    uint32_t offset = readOffset(frame);
+                    if (!isTruthy(stack.back()))
+                        frame->ip += offset;
+                    break;
+                }
+                case OP_JUMP_IF_TRUE: {
+                    uint32_t offset = readOffset(frame);
+                    if (isTruthy(stack.back()))
+                        frame->ip += offset;
+                    break;
+                }
+                case OP_LOOP: {
+                    uint32_t offset = readOffset(frame);
+                    frame->ip -= offset;
+                    collectIfNeeded();
+                    break;
+                }
+                case OP_PUSH_SCOPE: {
+                    env = new Environment(handler, env);
+                    break;
+                }
+                case OP_POP_SCOPE: {
+                    env = env->parent;
+                    break;
+                }
+                case OP_CALL: {
+                    int argCount = readShort(frame);
+                    Call* site = frame->chunk->calls[readIndex(frame)];
+                    // everything live is on the stack between instructions
+                    collectIfNeeded();
+                    callValue(frame, argCount, site);
+                    frame = &frames.back();
+                    break;
+                }
+                case OP_INVOKE: {
+                    int argCount = readShort(frame);
+                    Call* site = frame->chunk->calls[readIndex(frame)];
+                    collectIfNeeded();
+
+                    int receiverAt = stack.size() - argCount - 1;
+                    if (stack[receiverAt].isNone()) {
+                        // a field was found, so call it like any other value
+                        stack.erase(stack.begin() + receiverAt);
+                        callValue(frame, argCount, site);
+                    } else {
+                        invokeMethod(frame, (UserFunction*) stack[receiverAt - 1].asObject(), argCount);
+                    }
+                    frame = &frames.back();
+                    break;
+                }
+                case OP_FUNCTION: {
+                    Chunk* body = frame->chunk->functions[readIndex(frame)];
+                    UserFunction* fn = new UserFunction(body->decl, env);
+                    fn->chunk = body;
+                    stack.push_back(Value::object(fn));
+                    break;
+                }
+                case OP_CLASS: {
+                    ClassProto* proto = frame->chunk->classes[readIndex(frame)];
+                    Value super;
+                    if (proto->decl->superclass != NULL)
+                        super = pop();
+                    declareClass(this, proto->decl, super, &proto->methods);
+                    break;
+                }
+                case OP_RETURN: {
+                    Value result = pop();
+                    CallFrame done = frames.back();
+                    frames.pop_back();
+                    env = done.callerEnv;
+
+                    if (done.fn != NULL && done.fn->isInitializer) {
+                        // the receiver sits just above the method
+                        result = stack[done.base + 1];
+                    }
+                    stack.resize(done.base);
+
+                    if (frames.size() == entryDepth)
+                        return result;
+
+                    stack.push_back(result);
+                    frame = &frames.back();
+                    break;
+                }
+            }
+        }
+    }
+
+    void pushFrame(UserFunction* fn, Chunk* chunk, Environment* scope) {
+        CallFrame frame;
+        frame.fn = fn;
+        frame.chunk = chunk;
+        frame.ip = chunk->code.data();
+        frame.base = stack.size();
+        frame.callerEnv = env;
+        frames.push_back(frame);
+        env = scope;
+    }
+
+    // makes sure fn's chunk has been compiled, as
+    // a lazily parsed function's is on its first call
+    void compiled(UserFunction* fn) {
+        if (fn->chunk->code.empty()) {
+            Compiler compiler(this, handler, interacting);
+            fn->chunk = compiler.compileLazy(fn->chunk);
+        }
+    }
+
+    // calls the value sitting under argCount arguments on the stack
+    void callValue(CallFrame* frame, int argCount, Call* site) {
+        int calleeAt = stack.size() - argCount - 1;
+        Callable* fn = cachedCallee(site->cache, stack[calleeAt]);
+
+        if (fn == NULL) // not a callable, since it couldn't cast
+            throw RuntimeError(currentToken(frame), "Can only call functions and classes.");
+
+        hasArity(currentToken(frame), site->cache.arity, argCount);
+
+        if (typeid(*fn) == typeid(BoundMethod)) {
+            // unpack it into a method with its receiver above it
+            BoundMethod* bound = static_cast<BoundMethod*>(fn);
+            stack[calleeAt] = Value::object(bound->method);
+            stack.insert(stack.begin() + calleeAt + 1, bound->receiver);
+            invokeMethod(frame, bound->method, argCount);
+            return;
+        }
+
+        UserFunction* user = site->cache.user;
+        if (user != NULL && user->chunk != NULL) {
+            compiled(user);
+            // same scopes UserFunction::call builds: one for the
+            // parameters and one for the body
+            Environment* params = new Environment(handler, user->closure);
+            for (int i = 0; i < argCount; ++i) {
+                params->defineSlot(stack[calleeAt + 1 + i]);
+            }
+            pushFrame(user, user->chunk, new Environment(user->closure->handler, params));
+            frames.back().base = calleeAt;
+            return;
+        }
+
+        vector < Value > args(stack.begin() + calleeAt + 1, stack.end());
+        Value result = fn->call(this, args);
+        stack.resize(calleeAt);
+        stack.push_back(result);
+    }
+
+    // calls the method sitting under its receiver and argCount
+    // arguments on the stack, with the receiver as "this"
+    void invokeMethod(CallFrame* frame, UserFunction* method, int argCount) {
+        int calleeAt = stack.size() - argCount - 2;
+        hasArity(currentToken(frame), method->arity(), argCount);
+
+        if (method->chunk != NULL) {
+            compiled(method);
+            // same scopes UserFunction::invoke builds
+            Environment* params = new Environment(handler, method->closure);
+            for (int i = 0; i <= argCount; ++i) {
+                params->defineSlot(stack[calleeAt + 1 + i]);
+            }
+            pushFrame(method, method->chunk, new Environment(method->closure->handler, params));
+            frames.back().base = calleeAt;
+            return;
+        }
+
+        vector < Value > args(stack.begin() + calleeAt + 2, stack.end());
+        Value result = method->invoke(this, stack[calleeAt + 1], args);
+        stack.resize(calleeAt);
+        stack.push_back(result);
+    }
+
+    int readShort(CallFrame* frame) {
+        frame->ip += 2;
+        return (frame->ip[-2] << 8) | frame->ip[-1];
+    }
+
+    // a jump offset, 4 bytes wide so a jump can span any chunk
+    uint32_t readOffset(CallFrame* frame) {
+        frame->ip += 4;
+        return ((uint32_t) frame->ip[-4] << 24) | (frame->ip[-3] << 16) | (frame->ip[-2] << 8) | frame->ip[-1];
+    }
+
+    // an index operand, with the high bits an OP_WIDE just ahead gave it
+    uint32_t readIndex(CallFrame* frame) {
+        uint32_t index = wide | readShort(frame);
+        wide = 0;
+        return index;
+    }
+
+    // token carrying the line of the instruction being run, for errors
+    Token currentToken(CallFrame* frame) {
+        int offset = frame->ip - frame->chunk->code.data() - 1;
+        return Token(EOF_, frame->chunk->lines[offset]);
+    }
+
+    // pops 2 operands that must both be Numbers
+    void numberOperands(CallFrame* frame, double& l, double& r) {
+        Value re = pop();
+        Value le = pop();
+        areNumbers(currentToken(frame), le, re);
+        r = re.asNumber();
+        l = le.asNumber();
+    }
+
+    Value pop() {
+        Value top = stack.back();
+        stack.pop_back();
+        return top;
+    }
+
+    vector < Value > stack;
+    vector < CallFrame > frames;
+    uint32_t wide; // high bits of the next index read, set by OP_WIDE
+};
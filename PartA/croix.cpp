@@ -9,7 +9,13 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "Lexer/Lexer.h"
+#include "Lexer/ParallelLexer.h"
 #include "Helpers/ErrHandler.h"
 #include "AST/Expr.h"
 #include "AST/Stmt.h"
@@ -20,6 +26,11 @@
 #include "Interpreter/Interpreter.h"
 #include "Environment/Environment.h"
 #include "Resolver/Resolver.h"
+#include "ConstantFolder/ConstantFolder.h"
+#include "Image/Image.h"
+#include "VM/VM.h"
+#include "Flat/FlatInterpreter.h"
+#include "GC/Heap.h"
 
 using namespace std;
 
@@ -27,27 +38,83 @@ using namespace std;
 // shows error message otherwise
 bool hasCorrectArgCount(int c);
 
-// reads all the lines at found at path, if it exists
-// else it shows an error
-string readAllLines(string path);
+// pulls option flags (like --vm or --gc-stats) out of argv and
+// returns the remaining positional arguments
+vector < string > parseFlags(int argc, const char * argv[]);
+
+// the contents of the file at path, mapped read-only when it can be
+// (or read in, for pipes and the like). exits if it can't be opened
+const char* loadSource(string path, size_t& length);
 
 // takes a file path, reads it's contents and runs it
 void runFile(string path);
 
-// takes source code as a string and runs it
-void run(string src, bool interact=false);
+// runs a script compiled by --compile, when it is still up to
+// date with the script next to it (if that is still around)
+void runImage(string path);
+
+// writes the image of a resolved tree, compiled from length bytes
+// of source at text, to path
+void writeImage(string path, const char* text, size_t length, vector < Stmt* >& stmts);
+
+// runs length bytes of source code at text, which has
+// to stay put for as long as the program runs
+void run(const char* text, size_t length, bool interact=false);
+
+// the execution engine picked by the flags, running in env
+CInterpreter* newEngine(bool interact);
 
 // runs the repl loop for croix
 void runPrompt();
 
+// shows how fast source was lexed and parsed so far, in MB/s,
+// and how long resolving it took
+void reportParseStats();
+
+// lexes source (already in the source buffer at base) serially and then
+// in 2 to 8 chunks, and reports whether the tokens all came out the same
+void checkParallelLex(const char* text, size_t length, uint32_t base);
+
 ErrHandler CroixErrManager;
-Environment env(&CroixErrManager);
+Environment* env = new Environment(&CroixErrManager); // owned by the heap like every scope
+bool USE_VM = false; // run on the bytecode VM instead of the tree-walker
+bool USE_FLAT = false; // run off a flat tree instead of the tree-walker
+bool GC_STATS = false; // report what the collector did on exit
+bool IC_STATS = false; // report how the inline caches did on exit
+bool PARSE_STATS = false; // report lexer and parser throughput on exit
+bool ECHO_SOURCE = false; // print a script before running it
+bool FOLD = true; // fold constant expressions before running
+bool FOLD_STATS = false; // report how many nodes were folded on exit
+bool LEX_CHECK = false; // compare parallel lexing against serial lexing
+bool COMPILE = false; // write a script's image instead of running it
+bool LAZY = false; // parse top level function bodies on their first call
+int LEX_THREADS = 1; // lex big scripts on this many threads
+
+// with --compile, where run writes the image of the script it was given
+string compileTo = "";
+
+// the syntax trees of REPL lines that declared functions or classes.
+// those live on in the environment and point into their tree
+vector < Arena* > keptTrees;
+
+// totals behind --parse-stats
+size_t bytesLexed = 0;
+size_t tokensLexed = 0;
+size_t treeBytes = 0; // syntax tree nodes made
+int lazyFunctions = 0; // whose bodies were left unparsed
+int lazyBodiesParsed = 0; // of those, on a call
+int nodesFolded = 0; // behind --fold-stats
+double parseMillis = 0; // lexing included, since the two are interleaved
+double resolveMillis = 0; // of whole scripts (and REPL lines)
+size_t imageBytes = 0; // of compiled scripts loaded instead
+double imageMillis = 0;
 
 int main(int argc, const char * argv[]) {
-    if (hasCorrectArgCount(argc)) {
-        if (argc == 2) // user provided a script
-            runFile(argv[1]);
-        else if (argc == 1) // no path provided
+    vector < string > args = parseFlags(argc, argv);
+    if (hasCorrectArgCount(args.size() + 1)) {
+        if (args.size() == 1) // user provided a script
+            runFile(args[0]);
+        else if (args.size() == 0) // no path provided
             runPrompt();
     } else {
         return 64; // exit with an usage error
@@ -59,73 +126,290 @@ int main(int argc, const char * argv[]) {
 // shows error message otherwise
 bool hasCorrectArgCount(int c) {
     if (c > 2) {
-        cout << "usage -> crx <{script}>" << endl;
+        cout << "usage -> crx [--vm] [--flat] [--echo] [--gc-stats] [--ic-stats] [--parse-stats] [--no-fold] [--fold-stats] [--lazy] [--compile] [--no-simd] [--lex-threads=<n>] [--lex-check] [--gc-threshold=<bytes>] [--gc-growth=<factor>] <{script}>" << endl;
         return false;
     }
     return true;
 }
 
-// reads all the lines at found at path, if it exists
-// else it shows an error
-string readAllLines(string path) {
-    ifstream script(path);
-    
-    string contents;
-    if (script.is_open()) { // no problems getting to file and opening it
-        string line;
-        
-        while(getline(script, line)) { // loop till EOF is reached
-            contents += line + "\n"; // add each line to contents and add the discarded delimiter back
-        }
-    } else {
+// pulls option flags (like --vm or --gc-stats) out of argv and
+// returns the remaining positional arguments
+vector < string > parseFlags(int argc, const char * argv[]) {
+    vector < string > positional;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--vm")
+            USE_VM = true;
+        else if (arg == "--flat")
+            USE_FLAT = true;
+        else if (arg == "--echo")
+            ECHO_SOURCE = true;
+        else if (arg == "--gc-stats")
+            GC_STATS = true;
+        else if (arg == "--ic-stats")
+            IC_STATS = true;
+        else if (arg == "--parse-stats")
+            PARSE_STATS = true;
+        else if (arg == "--no-simd")
+            simdLevel() = SCALAR; // lex one byte at a time
+        else if (arg == "--no-fold")
+            FOLD = false;
+        else if (arg == "--fold-stats")
+            FOLD_STATS = true;
+        else if (arg == "--lex-check")
+            LEX_CHECK = true;
+        else if (arg == "--compile")
+            COMPILE = true;
+        else if (arg == "--lazy")
+            LAZY = true;
+        else if (arg.find("--lex-threads=") == 0)
+            LEX_THREADS = max(1, stoi(arg.substr(14)));
+        else if (arg.find("--gc-threshold=") == 0) {
+            heap().threshold = stoul(arg.substr(15));
+            heap().nextGC = heap().threshold;
+        } else if (arg.find("--gc-growth=") == 0)
+            heap().growth = stod(arg.substr(12));
+        else
+            positional.push_back(arg);
+    }
+    return positional;
+}
+
+// the contents of the file at path, mapped read-only when it can be
+// (or read in, for pipes and the like). exits if it can't be opened
+const char* loadSource(string path, size_t& length) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
         exit(74); // error while performing IO on some file
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            // the mapping outlives fd, and the program (tokens point into it)
+            close(fd);
+            length = info.st_size;
+            return (const char*) mapped;
+        }
     }
-    return contents;
+
+    string contents;
+    char chunk[1 << 16];
+    ssize_t got;
+    while ((got = read(fd, chunk, sizeof(chunk))) > 0) {
+        contents.append(chunk, got);
+    }
+    close(fd);
+    if (got < 0)
+        exit(74);
+
+    length = contents.size();
+    return sourceBuffer().keep(contents);
+}
+
+// where the image of the script at path goes, and the script
+// an image at path was compiled from: foo.cx and foo.crxc
+bool isImagePath(const string& path) {
+    return path.size() > 5 && path.compare(path.size() - 5, 5, ".crxc") == 0;
+}
+
+string imagePathFor(const string& path) {
+    if (path.size() > 3 && path.compare(path.size() - 3, 3, ".cx") == 0)
+        return path.substr(0, path.size() - 3) + ".crxc";
+    return path + ".crxc";
+}
+
+string sourcePathFor(const string& path) {
+    return path.substr(0, path.size() - 5) + ".cx";
 }
 
 // takes a file path, reads it's contents and runs it
 void runFile(string path) {
-    cout << "Running file -> " << path << endl;
-    string lines = readAllLines(path);
-
-    cout << "<----------------- File contents ----------------->\n";
-    cout << lines;
-    cout << "---------------------------------------------------\n\n";
-     
-    run(lines);
+    if (isImagePath(path) && !COMPILE) {
+        runImage(path);
+    } else {
+        size_t length;
+        const char* source = loadSource(path, length);
+
+        if (ECHO_SOURCE) {
+            cout << "Running file -> " << path << endl;
+            cout << "<----------------- File contents ----------------->\n";
+            cout.write(source, length);
+            if (length > 0 && source[length - 1] != '\n')
+                cout << '\n'; // the separator goes on a line of its own
+            cout << "---------------------------------------------------\n\n";
+        }
+
+        if (COMPILE)
+            compileTo = imagePathFor(path);
+        run(source, length);
+    }
+    if (GC_STATS) heap().report();
+    if (IC_STATS) cacheStats().report();
+    if (PARSE_STATS) reportParseStats();
+    if (FOLD_STATS) cout << "[fold] " << nodesFolded << " nodes folded" << endl;
     if (CroixErrManager.SOURCE_HAD_ERROR) exit(65); // incorrect input error
     if (CroixErrManager.RUNTIME_ERROR) exit(70);
 }
 
-// takes source code as a string and runs it
-void run(string src, bool interact) {
-    // do nothing for now
-    Lexer crxLex(src, &CroixErrManager);
-    vector < Token > tokens = crxLex.lexTokens(); 
-
-    bool v = CroixErrManager.SOURCE_HAD_ERROR;
-    
-    if (v) 
+// runs length bytes of source code at text, which has
+// to stay put for as long as the program runs
+void run(const char* text, size_t length, bool interact) {
+    if (sourceBuffer().size + length > UINT32_MAX) {
+        CroixErrManager.error(0, "Source is too large, past 4GB in all.");
         return;
+    }
 
-    Parser p(tokens, &CroixErrManager);
+    // the parser pulls tokens from the lexer as it goes
+    chrono::steady_clock::time_point parseStart = chrono::steady_clock::now();
+    Lexer crxLex(text, length, &CroixErrManager);
+    if (LEX_CHECK)
+        checkParallelLex(text, length, crxLex.sourceBase());
+    if (LEX_THREADS > 1) {
+        // the parser then takes the tokens as they were lexed ahead
+        vector < Token > tokens;
+        if (lexParallel(text, length, crxLex.sourceBase(), LEX_THREADS, tokens))
+            crxLex.replay(tokens);
+    }
+    Arena* tree = new Arena(); // every node of this parse
+    Parser p(&crxLex, &CroixErrManager, tree);
+    p.lazy = LAZY && !COMPILE && !interact; // an image holds every body, and a line is small
     vector < Stmt* > stmts = p.parse();
+    parseMillis += chrono::duration < double, milli >(chrono::steady_clock::now() - parseStart).count();
+    bytesLexed += length;
+    tokensLexed += crxLex.tokenCount;
+    treeBytes += tree->bytes;
+    lazyFunctions += p.lazyFunctions;
 
-    v = CroixErrManager.SOURCE_HAD_ERROR;
+    bool v = CroixErrManager.SOURCE_HAD_ERROR;
 
-    if (v) 
+    if (v) {
+        delete tree;
         return;
+    }
 
-    Interpreter in(&CroixErrManager, interact, &env);
-    Resolver res(&in, &CroixErrManager);
+    CInterpreter* in = newEngine(interact);
+
+    chrono::steady_clock::time_point resolveStart = chrono::steady_clock::now();
+    Resolver res(&CroixErrManager);
     res.resolveStmts(stmts);
+    resolveMillis += chrono::duration < double, milli >(chrono::steady_clock::now() - resolveStart).count();
 
     v = CroixErrManager.SOURCE_HAD_ERROR;
 
-    if (v) 
-        return;
+    if (!v && FOLD) {
+        ConstantFolder folder(tree);
+        folder.foldStmts(stmts);
+        nodesFolded += folder.folded;
+    }
 
-    in.interpret(stmts);
+    if (!v && compileTo != "")
+        writeImage(compileTo, text, length, stmts);
+    else if (!v)
+        in->interpret(stmts);
+    delete in;
+
+    // the whole tree goes at once, unless the REPL still needs it
+    if (interact && p.declaredCallables)
+        keptTrees.push_back(tree);
+    else
+        delete tree;
+}
+
+// the execution engine picked by the flags, running in env
+CInterpreter* newEngine(bool interact) {
+    if (USE_VM)
+        return new VM(&CroixErrManager, interact, env);
+    if (USE_FLAT)
+        return new FlatInterpreter(&CroixErrManager, interact, env);
+    return new Interpreter(&CroixErrManager, interact, env);
+}
+
+// parses, resolves and folds the body of a lazily parsed function.
+// only its braces were matched at startup, so this is where its
+// syntax and scoping errors are found. past any, the script stops
+// as it would have before running, had the body been parsed then
+Block* parseLazyBody(Function* f) {
+    LazyBody* lazy = f->lazy;
+    Lexer lexer(sourceBuffer().at(lazy->offset), lazy->length, lazy->offset, lazy->line, &symbols(), &CroixErrManager);
+    Parser p(&lexer, &CroixErrManager, lazy->arena);
+    try {
+        f->body = p.body();
+    } catch (ParseError&) {
+        // reported already
+    }
+
+    if (!CroixErrManager.SOURCE_HAD_ERROR) {
+        Resolver res(&CroixErrManager);
+        if (lazy->owner == NULL)
+            res.resolveLazyBody(f, NOCLASS);
+        else
+            res.resolveLazyBody(f, lazy->owner->superclass != NULL ? SUBCLASS : SOMECLASS);
+    }
+    if (CroixErrManager.SOURCE_HAD_ERROR)
+        exit(65); // incorrect input error
+
+    if (FOLD) {
+        ConstantFolder folder(lazy->arena);
+        folder.foldStmts(f->body->stmts);
+        nodesFolded += folder.folded;
+    }
+    lazyBodiesParsed++;
+    return f->body;
+}
+
+// runs a script compiled by --compile, when it is still up to
+// date with the script next to it (if that is still around)
+void runImage(string path) {
+    size_t size;
+    const char* image = loadSource(path, size);
+
+    CInterpreter* in = newEngine(false);
+
+    chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+    Arena* tree = new Arena();
+    ImageReader reader(tree);
+    vector < Stmt* > stmts;
+    bool ok = reader.open(image, size);
+    if (ok) {
+        // a script that has changed since is run as it is now
+        string source = sourcePathFor(path);
+        struct stat info;
+        if (stat(source.c_str(), &info) == 0) {
+            size_t length;
+            const char* text = loadSource(source, length);
+            if (length != reader.header->sourceLength ||
+                hashBytes(text, length) != reader.header->sourceHash) {
+                delete in;
+                delete tree;
+                run(text, length);
+                return;
+            }
+        }
+        ok = reader.read(stmts);
+    }
+    imageMillis += chrono::duration < double, milli >(chrono::steady_clock::now() - loadStart).count();
+    imageBytes += size;
+    treeBytes += tree->bytes;
+
+    if (ok)
+        in->interpret(stmts);
+    else
+        CroixErrManager.error(0, path + " " + reader.problem + ".");
+    delete in;
+    delete tree;
+}
+
+// writes the image of a resolved tree, compiled from length bytes
+// of source at text, to path
+void writeImage(string path, const char* text, size_t length, vector < Stmt* >& stmts) {
+    ImageWriter writer;
+    string image = writer.write(stmts, text, length);
+    ofstream out(path.c_str(), ios::binary);
+    out.write(image.data(), image.size());
+    out.close();
+    if (!out)
+        CroixErrManager.error(0, "Could not write " + path + ".");
 }
 
 // runs the repl for interactive program
@@ -141,9 +425,65 @@ void runPrompt() {
             continue; // empty code line, skip
         if (line == TERMINATE) { // terminate repl
             cout << "...bye..." << endl;
+            if (GC_STATS) heap().report();
+            if (IC_STATS) cacheStats().report();
+            if (PARSE_STATS) reportParseStats();
+            if (FOLD_STATS) cout << "[fold] " << nodesFolded << " nodes folded" << endl;
             break;
         }
-        run(line, true); // execute line
+        run(sourceBuffer().keep(line), line.size(), true); // execute line
         CroixErrManager.SOURCE_HAD_ERROR = false; // reset flag so it doesn't kill session for user
     }
 }
+
+// shows how fast source was lexed and parsed so far, in MB/s,
+// and how long resolving it took
+void reportParseStats() {
+    double mb = bytesLexed / (1024.0 * 1024.0);
+    cout << "[parse] " << bytesLexed << " bytes, " << tokensLexed << " tokens (" << sizeof(Token) << " bytes each)" << endl;
+    cout << "[parse] " << treeBytes << " bytes of syntax tree" << endl;
+    if (lazyFunctions > 0)
+        cout << "[parse] " << lazyFunctions << " function bodies parsed lazily, " << lazyBodiesParsed << " of them on a call" << endl;
+    cout << "[parse] lexed and parsed in " << parseMillis << "ms (" << mb / (parseMillis / 1000) << " MB/s)" << endl;
+    cout << "[parse] resolved in " << resolveMillis << "ms" << endl;
+    if (flatStats().nodes > 0)
+        flatStats().report();
+    if (imageBytes > 0)
+        cout << "[parse] " << imageBytes << " bytes of compiled script loaded in " << imageMillis << "ms" << endl;
+}
+
+// lexes source (already in the source buffer at base) serially and then
+// in 2 to 8 chunks, and reports whether the tokens all came out the same
+void checkParallelLex(const char* text, size_t length, uint32_t base) {
+    Lexer serial(text, length, base, 1, &symbols(), NULL);
+    vector < Token > expected = serial.lexTokens();
+
+    int mismatches = 0;
+    for (int chunks = 2; chunks <= 8; ++chunks) {
+        vector < Token > got;
+        // chunks of any size, so even small scripts are split up
+        if (!lexParallel(text, length, base, chunks, got, 1))
+            continue; // lexed serially, so there is nothing to compare
+        if (serial.hadError) {
+            cout << "[lex-check] " << chunks << " chunks: lexed past a lexing error" << endl;
+            mismatches++;
+            continue;
+        }
+
+        size_t i = 0;
+        while (i < expected.size() && i < got.size()) {
+            Token& a = expected[i];
+            Token& b = got[i];
+            if (a.type != b.type || a.offset != b.offset || a.length != b.length ||
+                a.line != b.line || a.column != b.column || a.symbol != b.symbol)
+                break;
+            i++;
+        }
+        if (i < expected.size() || i < got.size()) {
+            cout << "[lex-check] " << chunks << " chunks: token " << i << " differs (line "
+                 << (i < expected.size() ? expected[i].line : got[i].line) << ")" << endl;
+            mismatches++;
+        }
+    }
+    cout << "[lex-check] " << expected.size() << " tokens, " << mismatches << " mismatches" << endl;
+}
@@ -38,7 +38,9 @@ sclasses = [
         "While",
         "Function",
         "Return", 
-        "Class"
+        "Class",
+        "Break",
+        "Continue"
     ]
 
 eclasses = [
@@ -60,30 +62,23 @@ eclasses = [
         # "Lambda" # Callable Expr type
     ]
 
-mp = {
-        "Binary" : 'b',
-        "Unary": 'U',
-        "Grouping": 'G',
-        "Boolean": 'B',
-        "Number": 'N',
-        "String": 's',
-        "Expression" : 'E',
-        "Print": 'P',
-        "Var": 'V',
-        "Variable": 'v',
-        "Block": '{',
-        "If" : 'i',
-        "Logical": 'L',
-        "While": 'W',
-        "Call": 'C',
-        "Function": 'F',
-        "Return": 'R',
-        "Class": 'c',
-        "Get": 'g',
-        "Set": 'S',
-        "This": 'T',
-        "Super": 'p',
-        # "Lambda": 'l'
+# runtime inline caches kept on some nodes. they are
+# members, but not constructor parameters
+siteCaches = {
+        "Get": "PropertyCache cache",
+        "Set": "PropertyCache cache",
+        "Super": "PropertyCache cache",
+        "Call": "CallCache cache",
+    }
+
+# nodes that name a variable keep where the Resolver found it,
+# which is the globals until it says otherwise
+resolvedNames = ["Variable", "Assign", "This", "Super"]
+
+# state set on some nodes after they are made, so also not
+# constructor parameters: the member, and what it starts out as
+lateMembers = {
+        "Function": ("LazyBody* lazy", "NULL", "where the body is, while it is left unparsed"),
     }
 
 # add top comments and include statements
@@ -104,125 +99,101 @@ def addTopOfFile(Cpp: CodeAssembler, baseClass: str, stmt=False):
     Cpp.insert("#include <iostream>")
     Cpp.insert("#include <string>")
     Cpp.insert('#include "Token.h"')
+    Cpp.insert('#include "Arena.h"')
+    if not stmt:
+        Cpp.insert('#include "Value.h"')
+        Cpp.insert('#include "InlineCache.h"')
+        Cpp.insert('#include "LocalSlot.h"')
     if stmt:
         Cpp.insert('#include "Expr.h"')
+        Cpp.insert('#include "Completion.h"')
         Cpp.insert("#include <vector>")
     # else:
     #     Cpp.insert('#include "Stmt.h"')
     Cpp.insert()
     Cpp.insert("using namespace std;")
 
-def defineVisitableGeneric(Cpp: CodeAssembler, pairCount: int, vStr: str="Visitable"):
-    Cpp.insert()
-    Cpp.insert("// class to be inherited by abstract base class")
-    Cpp.insert("// to allow the template defined types visit this class")
-    Cpp.insert("// it is visited by V1 and returns R1")
-    Cpp.insert("// it is visited by V2 and returns R2")
-    
-    # use pair count to generate the appropriate pair of Visitor
-    # and VisitorReturnVal
-    # so each Vistor is next to its Return value in the template
-    tStr = "template < "
-    acceptFns = []
-    for i in range(1, pairCount+1):
-        # we are now past the first one, so we can add newline
-        # to tStr
-        vTag = "V" + str(i)
-        rTag = "R" + str(i)
-        v = "typename " + vTag
-        r = "typename " + rTag
-        tStr += v + ', ' + r
-        fn = f"virtual {rTag} accept({vTag}) = 0;"
-        acceptFns.append(fn)
-
-        if i+1 != pairCount + 1:
-            tStr += ', '
-
-    # replace last comma with > to close template 
-    tStr = tStr[0:len(tStr)] + " >"
-    Cpp.insert(tStr)
-    Cpp.insert(f"class {vStr} " + "{")
-    Cpp.insert("public:")
-    
-    for fn in acceptFns:
-        Cpp.indentInsertDedent(fn)
-    Cpp.insert("};")
-
 def forwardDeclareClasses(Cpp: CodeAssembler, classes: list[str]):
     Cpp.insert()
     
     for cl in classes:
         Cpp.insert(f"class {cl};")
 
+def nodeKind(className: str) -> str:
+    return "NODE_" + className.upper()
+
+def defineNodeKinds(Cpp: CodeAssembler):
+    Cpp.insert()
+    Cpp.insert("// every kind of node there is, expressions first and then statements.")
+    Cpp.insert("// a node keeps its own, which visitors switch on to find its class")
+    Cpp.insert("enum NodeKind {")
+    Cpp.indent()
+    Cpp.insert(', '.join(nodeKind(cl) for cl in eclasses) + ',')
+    Cpp.insert(', '.join(nodeKind(cl) for cl in sclasses))
+    Cpp.dedent()
+    Cpp.insert("};")
+
 def defineVisitorGeneric(Cpp: CodeAssembler, classes: list[str], baseClass: str, typeTag: str = "Expr"):
     Cpp.insert()
-    Cpp.insert("// class to be inherited by classes that intend to visit")
+    Cpp.insert("// to be inherited by classes that intend to visit, as in")
+    Cpp.insert(f"// class Foo : public {typeTag}Visitor < Foo, ReturnValue >. visit{typeTag}")
+    Cpp.insert("// hands a node to Foo's visit function for its kind with a single")
+    Cpp.insert("// switch, and (as they aren't virtual) those can be inlined into it")
     rTag = "ReturnValue"
-    Cpp.insert(f"template < typename {rTag} >")
+    Cpp.insert(f"template < typename Visitor, typename {rTag} >")
     Cpp.insert(f"class {typeTag}Visitor " + "{")
     Cpp.insert("public:")
-    
+    Cpp.indent()
+    Cpp.insert(f"{rTag} visit{typeTag}({baseClass}* node) " + "{")
+    Cpp.indent()
+    Cpp.insert("Visitor* v = static_cast < Visitor* >(this);")
+    Cpp.insert("switch (node->kind) {")
+    Cpp.indent()
     for cl in classes:
-        ln = f"virtual {rTag} visit{cl}{baseClass}({cl}*) = 0;"
-        Cpp.indentInsertDedent(ln)
+        Cpp.insert(f"case {nodeKind(cl)}: return v->visit{cl}{baseClass}(static_cast < {cl}* >(node));")
+    Cpp.insert(f"default: return {rTag}();")
+    Cpp.dedent()
+    Cpp.insert("}")
+    Cpp.dedent()
+    Cpp.insert("}")
+    Cpp.dedent()
     Cpp.insert("};")
 
-def defineBaseClass(Cpp: CodeAssembler, baseClass: str, stmt=False):
+def defineBaseClass(Cpp: CodeAssembler, baseClass: str):
     Cpp.insert()
-    Cpp.insert("// anything that is an ExprVisitor can visit this class")
-
-
-    # build the Visitable inheritance statement:
-    returns : list[str]
-
-    if stmt:
-        returns = ["void"]
-    else:
-        returns = ["string", "Storable *", "void"]
-
-    if stmt:
-        inher = "public VisitableStmt < "
-        #  build the Visitable inheritance statement:
-    else:
-        inher = "public Visitable < "
-
-    for i in range(len(returns)):
-        r = returns[i]
-        if stmt:
-            inher += f"StmtVisitor < {r} > *, {r}"
-        else:
-            inher += f"ExprVisitor < {r} > *, {r}"
-
-        if i+1 != len(returns):
-            inher += ', '
-    inher += " >"
-
-    if stmt:
-        Cpp.insert(f"class {baseClass} : {inher} " + "{")
-    else:
-        Cpp.insert(f"class {baseClass} : {inher}" + ", public Storable {")
+    Cpp.insert(f"// what every {baseClass.lower()} node is. nodes have no virtual functions (and")
+    Cpp.insert("// so no vtable): what a node is is told by its kind alone")
+    Cpp.insert(f"class {baseClass} " + "{")
     Cpp.insert("public:")
-    Cpp.indentInsertDedent("virtual char type() const = 0;")
-    if not stmt:
-        Cpp.insert();
-        Cpp.indentInsertDedent("string storedType() {")
-        Cpp.indent()
-        Cpp.indentInsertDedent('return "Expr";')
-        Cpp.dedent()
-        Cpp.indentInsertDedent("}")
-    Cpp.insert();
-    Cpp.indentInsertDedent(f"virtual ~{baseClass}() " + "{ }")
+    Cpp.indent()
+    Cpp.insert("uint8_t kind; // a NodeKind")
+    Cpp.insert()
+    Cpp.insert("// nodes are only made in the Arena of their parse, as in")
+    Cpp.insert("// new (arena) Node(...), and go when the arena does")
+    Cpp.insert("static void* operator new(size_t size, Arena& arena) {")
+    Cpp.indentInsertDedent("return arena.allocate(size);")
+    Cpp.insert("}")
+    Cpp.insert("static void operator delete(void*, Arena&) { }")
+    Cpp.insert("static void operator delete(void*) { }")
+    Cpp.dedent()
+    Cpp.insert()
+    Cpp.insert("protected:")
+    Cpp.indentInsertDedent(f"{baseClass}(NodeKind k) " + "{")
+    Cpp.indent()
+    Cpp.indentInsertDedent("kind = k;")
+    Cpp.insert("}")
+    Cpp.dedent()
     Cpp.insert("};")
 
-def defineType(Cpp: CodeAssembler, baseClass: str, className: str, fieldList: str, stmt: bool = False):
+def defineType(Cpp: CodeAssembler, baseClass: str, className: str, fieldList: str):
     # start of new class 
-    Cpp.insert(f"class {className} : public {baseClass} " + "{")
+    Cpp.insert(f"class {className} final : public {baseClass} " + "{")
 
     Cpp.insert("public:")
     # indent into definition of class
     Cpp.indent()
     # constructor
-    Cpp.insert(f"{className}({fieldList}) " + "{")
+    Cpp.insert(f"{className}({fieldList}) : {baseClass}({nodeKind(className)}) " + "{")
 
     # constructor body
     fields = fieldList.split(', ')
@@ -235,58 +206,24 @@ def defineType(Cpp: CodeAssembler, baseClass: str, className: str, fieldList: st
                 varName = f.split(" ")[1].strip()
 
             Cpp.indentInsertDedent(f"this->{varName} = {varName};")
+    late = lateMembers.get(className, None)
+    if late:
+        lateName = late[0].split(" ")[1]
+        Cpp.indentInsertDedent(f"this->{lateName} = {late[1]};")
     Cpp.insert("}")
 
-    Cpp.insert()
-    # destructor
-    Cpp.insert(f"~{className}() " + "{")
-    # destructor body
-    for f in fields:
-        if '*' in f and '>' not in f: # is a pointer, delete it
-            # print(f"{f} is a pointer")
-            member = f.split('*')[1].strip()
-            Cpp.indentInsertDedent(f"delete this->{member};")
-        if 'vector' in f and '*' in f: # a vector of pointers, delete them
-            vec = f.split(">")[1].strip()
-            Cpp.indentInsertDedent(f"for(int i = 0; i < {vec}.size(); ++i) " + "{")
-            Cpp.indent()
-            Cpp.indentInsertDedent(f"delete {vec}[i];")
-            Cpp.dedent()
-            Cpp.indentInsertDedent("}")
-            # print(vec)
-    Cpp.insert("}")
-
-    # generate necessary accept functions
-    returns : list[str]
-
-    if stmt:
-        returns = ["void"]
-    else:
-        returns = ["string", "Storable *", "void"]
-    
-    for r in returns:
+    # nodes with members that own memory (a vector or string) have
+    # their destructor run when the arena goes. nothing else does
+    if any('vector' in f or f.startswith('string ') for f in fields):
         Cpp.insert()
-        if stmt:
-            fnDef = f"{r} accept(StmtVisitor< {r} >* ev) " + "{"
-        else:
-            fnDef = f"{r} accept(ExprVisitor< {r} >* ev) " + "{"
-        Cpp.insert(fnDef)
-
-        if r == "void":
-            Cpp.indentInsertDedent(f"ev->visit{className}{baseClass}(this);")
-        else:
-            Cpp.indentInsertDedent(f"return ev->visit{className}{baseClass}(this);")
+        Cpp.insert("static void* operator new(size_t size, Arena& arena) {")
+        Cpp.indentInsertDedent(f"return arena.allocate(size, Arena::destroyNode < {className} >);")
         Cpp.insert("}")
-    
-    Cpp.insert()
-    Cpp.insert("char type() const {")
-    
-    tag = mp.get(className, None)
-    if tag:
-        Cpp.indentInsertDedent(f"return '{tag}';")
-    else:
-        Cpp.indentInsertDedent("return \'\\0\';")
-    Cpp.insert("}")
+        Cpp.insert("static void operator delete(void* node, Arena& arena) {")
+        Cpp.indentInsertDedent("arena.forget(node); // never built")
+        Cpp.insert("}")
+        Cpp.insert("static void operator delete(void*) { }")
+
     Cpp.dedent()
 
     Cpp.insert()
@@ -300,19 +237,16 @@ def defineType(Cpp: CodeAssembler, baseClass: str, className: str, fieldList: st
     if UNNEEDEDSPACE: # used Nil to keep formatting nice
         Cpp.unaddLastLine()
 
-    Cpp.insert("};")
-    Cpp.dedent()
+    cache = siteCaches.get(className, None)
+    if cache:
+        Cpp.indentInsertDedent(cache + "; // filled in as the node runs")
+    if late:
+        Cpp.indentInsertDedent(f"{late[0]}; // {late[2]}")
+    if className in resolvedNames:
+        Cpp.indentInsertDedent("LocalSlot local; // set by the Resolver")
 
-def defineStorableInterface(Cpp: CodeAssembler):
-    Cpp.insert()
-    Cpp.insert("// used by Environment to store both Exprs")
-    Cpp.insert("// and Callables like native functions and")
-    Cpp.insert("// user defined functions")
-    Cpp.insert()
-    Cpp.insert("class Storable {") 
-    Cpp.insert("public:")
-    Cpp.indentInsertDedent("virtual string storedType() = 0;")
     Cpp.insert("};")
+    Cpp.dedent()
 
 def writeOut(path: str, Cpp: CodeAssembler):
     print("writing to", path)
@@ -326,11 +260,7 @@ def generateExprHeaderForTypes(outDir: str, baseClass: str, types: list[str]):
     addTopOfFile(Cpp, baseClass)    
 
     forwardDeclareClasses(Cpp, eclasses)
-
-    # ASTPrinter, Interpreter, Resolver
-    defineVisitableGeneric(Cpp, 3)
-    defineVisitorGeneric(Cpp, eclasses, baseClass)
-    defineStorableInterface(Cpp)
+    defineNodeKinds(Cpp)
 
     defineBaseClass(Cpp, baseClass)
     
@@ -339,6 +269,9 @@ def generateExprHeaderForTypes(outDir: str, baseClass: str, types: list[str]):
         className = t.split(':')[0].strip()
         fields = t.split(':')[1].strip()
         defineType(Cpp, baseClass, className, fields)
+
+    # after the nodes, which it casts to
+    defineVisitorGeneric(Cpp, eclasses, baseClass)
     
     writeOut(outPath, Cpp)
 
@@ -349,15 +282,16 @@ def generateStmtHeaderForTypes(outDir: str, baseClass: str, types: list[str]):
     addTopOfFile(Cpp, baseClass, True)
 
     forwardDeclareClasses(Cpp, sclasses)
-    defineVisitableGeneric(Cpp, 1, "VisitableStmt")
-    defineVisitorGeneric(Cpp, sclasses, baseClass, "Stmt")
+    Cpp.insert("class LazyBody;")
 
-    defineBaseClass(Cpp, baseClass, stmt=True)
+    defineBaseClass(Cpp, baseClass)
     for t in types:
         Cpp.insert()
         className = t.split(':')[0].strip()
         fields = t.split(':')[1].strip()
-        defineType(Cpp, baseClass, className, fields, stmt=True)
+        defineType(Cpp, baseClass, className, fields)
+
+    defineVisitorGeneric(Cpp, sclasses, baseClass, "Stmt")
    
     writeOut(outPath, Cpp)
 
@@ -397,9 +331,11 @@ sTypes = [
     "Var            :  Token name, Expr* initValue",
     "Block          :  vector < Stmt* > stmts",
     "If             :  Expr* cond, Stmt* then, Stmt* else_",
-    "While          :  Expr* cond, Stmt* body",
+    "While          :  Expr* cond, Stmt* body, Expr* increment",
     "Function       :  Token fnName, vector < Token > params, Block* body",
     "Return         :  Token ret, Expr* value",
     "Class          :  Token name, Variable* superclass, vector < Function* > methods",
+    "Break          :  Token keyword",
+    "Continue       :  Token keyword",
 ]
-# generateStmtHeaderForTypes(dest, stmtBaseClass, sTypes)
+generateStmtHeaderForTypes(dest, stmtBaseClass, sTypes)
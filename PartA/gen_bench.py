@@ -0,0 +1,89 @@
+import sys
+
+# writes a large, valid Croix script for measuring how fast crx
+# lexes, parses and resolves.
+# usage: python3 gen_bench.py <megabytes> <out path> [mixed|wide|deep]
+# then run: crx --parse-stats <out path> > /dev/null
+# (the stats are the last lines printed)
+#   mixed: functions, classes and top level code (the default)
+#   wide: functions with many locals in one scope, using globals
+#   deep: functions whose blocks nest a hundred deep, using names
+#         from every level out to the globals
+
+# locals declared by each function of a wide script
+WIDE_LOCALS = 100
+
+# blocks nested in each function of a deep script
+DEEP_LEVELS = 100
+
+def block(i: int) -> str:
+    return f"""// block {i}: a function, a class and some top level code
+fun helper{i}(a, b, c) {{
+    var total = a * {i % 97} + b / {i % 13 + 1} - c;
+    if (total > 100 and a != b or c == nil) {{
+        total = total - 1;
+    }} else {{
+        total = total + 2.5;
+    }}
+    for (var k = 0; k < 3; k = k + 1) {{
+        if (k == 2) break;
+        total = total + k;
+    }}
+    return total;
+}}
+
+class Shape{i} {{
+    init(w, h) {{
+        this.w = w;
+        this.h = h;
+        this.label = "shape number {i} with a longer string literal";
+    }}
+    area() {{ return this.w * this.h; }}
+    scaled(f) {{ return Shape{i}(this.w * f, this.h * f); }}
+}}
+
+var s{i} = Shape{i}({i % 7 + 1}, {i % 5 + 2});
+var r{i} = helper{i}(s{i}.area(), {i}, !false ? 1 : 2);
+while (r{i} > 1000) r{i} = r{i} / 2;
+
+"""
+
+def wideBlock(i: int) -> str:
+    lines = [f"var g{i} = {i};", f"fun wide{i}(a, b) {{", f"    var v0 = a + g{i};"]
+    for k in range(1, WIDE_LOCALS):
+        lines.append(f"    var v{k} = v{k - 1} + v{k // 2} * b - g{i};")
+    lines.append(f"    return v{WIDE_LOCALS - 1};")
+    lines.append("}")
+    return "\n".join(lines) + "\n\n"
+
+def deepBlock(i: int) -> str:
+    lines = [f"var g{i} = {i};", f"fun deep{i}(a) {{", "    var x0 = a;"]
+    # not indented by level, so the script's size is mostly code
+    for k in range(1, DEEP_LEVELS):
+        lines.append("    {")
+        lines.append(f"    var x{k} = x{k - 1} + x0 * a - g{i};")
+    lines.append("    " + "}" * (DEEP_LEVELS - 1))
+    lines.append("    return x0;")
+    lines.append("}")
+    return "\n".join(lines) + "\n\n"
+
+shapes = {"mixed": block, "wide": wideBlock, "deep": deepBlock}
+
+def main():
+    if len(sys.argv) not in (3, 4) or (len(sys.argv) == 4 and sys.argv[3] not in shapes):
+        print("usage: python3 gen_bench.py <megabytes> <out path> [mixed|wide|deep]")
+        sys.exit(64)
+
+    shape = shapes[sys.argv[3] if len(sys.argv) == 4 else "mixed"]
+    target = float(sys.argv[1]) * 1024 * 1024
+    written = 0
+    i = 0
+    with open(sys.argv[2], "w") as out:
+        while written < target:
+            text = shape(i)
+            out.write(text)
+            written += len(text)
+            i += 1
+    print(f"wrote {written} bytes ({i} blocks) to {sys.argv[2]}")
+
+main()